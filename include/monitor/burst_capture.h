@@ -0,0 +1,98 @@
+#ifndef BURST_CAPTURE_H
+#define BURST_CAPTURE_H
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "frame_bus.h"
+
+// 连拍参数
+struct BurstOptions {
+    std::string directory = ".";     // 每次连拍在其下新建 burst_YYYYmmdd_HHMMSS_mmm 目录
+    std::string extension = ".png";  // .png 无损；.jpg 更快更小
+    int jpeg_quality = 95;
+    int png_compression = 1;         // 压缩级别只影响大小，低级别编码快得多
+    int workers = 0;                 // 编码线程数，0 表示 CPU 核数减 1（给采集线程留一个核）
+    int timeout_ms = 2000;           // 帧源停顿这么久还没凑齐时，只编码已收到的帧
+};
+
+enum class BurstState {
+    Idle,
+    Capturing,  // 正在收集帧
+    Encoding,   // 帧已收齐，正在并行编码
+    Done,
+    Failed,     // 目录无法创建或一帧也没收到
+};
+
+// 连拍进度和耗时
+struct BurstProgress {
+    BurstState state = BurstState::Idle;
+    size_t requested = 0;
+    size_t captured = 0;
+    size_t encoded = 0;
+    size_t failed = 0;         // 编码或写文件失败的帧
+    uint64_t missed = 0;       // 连拍期间帧源自己丢掉的帧（驱动序号缺口）；总线一侧不会丢
+    double span_ms = 0.0;      // 第一帧到最后一帧的采集时间跨度
+    double capture_ms = 0.0;   // 开始到收齐的耗时
+    double encode_ms = 0.0;    // 收齐到全部写完的耗时
+    std::string directory;     // 图像序列 frame_0001.png ... 和 timestamps.csv 所在目录
+};
+
+// 连拍：作为总线的一个订阅者，为连拍预留 N 个队列槽位（丢新不丢旧），
+// 收到的帧只增加像素缓冲区的引用计数，不拷贝；帧源发现缓冲区仍被引用时会另分配，
+// 所以显示和录制照常拿到每一帧。收齐后在线程池上并行编码成图像序列。
+// "最近 N 帧"由一个常驻的历史订阅提供（丢旧），取回时换上新的历史订阅，不留空档。
+// start_next/start_last/cancel/wait 由同一个控制线程调用，progress() 可在任意线程调用
+class BurstCapture {
+    FrameBus& bus;
+
+    std::mutex history_mutex;
+    std::shared_ptr<FrameSubscription> history;  // 受 history_mutex 保护
+    std::atomic<size_t> history_frames{0};
+
+    std::thread worker;
+    std::atomic<bool> cancelling{false};
+    std::atomic<bool> capturing{false};
+    std::shared_ptr<FrameSubscription> subscription;  // 当前连拍，只由连拍线程访问
+    BurstOptions options;
+    mutable std::mutex progress_mutex;
+    BurstProgress current;  // 受 progress_mutex 保护
+
+    SubscriberOptions history_options(size_t frames) const;
+    // 不在连拍时回收上一次的线程并建好输出目录
+    bool prepare(size_t frames, const BurstOptions& options);
+    void run(std::vector<TimedFrame> frames, size_t wanted);
+    void collect(std::vector<TimedFrame>& frames, size_t wanted);
+    void encode(std::vector<TimedFrame>& frames);
+public:
+    explicit BurstCapture(FrameBus& bus);
+    BurstCapture(const BurstCapture&) = delete;
+    BurstCapture& operator=(const BurstCapture&) = delete;
+    // 停止收集，等已收到的帧写完
+    ~BurstCapture();
+
+    // 常驻保留最近 frames 帧（占 frames 帧的 BGR 内存），0 关闭
+    void set_history(size_t frames);
+    size_t get_history() const { return history_frames.load(); }
+
+    // 从下一帧开始收集 frames 帧；上一次连拍还没结束时返回 false
+    bool start_next(size_t frames, const BurstOptions& options = BurstOptions());
+    // 取回此刻之前的最多 frames 帧（需先 set_history）；没有历史帧或上一次连拍未结束时返回 false
+    bool start_last(size_t frames, const BurstOptions& options = BurstOptions());
+    // 提前结束收集，已收到的帧照常编码
+    void cancel();
+    // 等当前连拍写完，返回最终进度
+    BurstProgress wait();
+
+    bool is_busy() const;
+    // 正在收集帧：采集线程据此暂停抽帧，按传感器全帧率发布
+    bool is_capturing() const { return capturing.load(); }
+    BurstProgress progress() const;
+};
+
+#endif // BURST_CAPTURE_H
@@ -9,43 +9,165 @@
 #include <linux/videodev2.h>
 #include <opencv2/opencv.hpp>
 #include <string>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include "frame_source.h"
 
-struct BufferInfo {
+// 一块 mmap 内存（多平面缓冲区的一个内存平面）
+struct PlaneInfo {
     void* start;
     size_t length;
 };
 
-class Camera { 
-    std::string device_path;
-    int fd;
-    struct v4l2_format fmt;
-    struct v4l2_buffer buf;
-    unsigned int buffer_count;  // 缓冲区数量
-    BufferInfo* buffers;  // 缓冲区数组
-    unsigned int current_buffer;  // 当前处理的缓冲区索引
-    // 清理缓冲区的辅助函数
-    void cleanup_buffers() {
+struct BufferInfo {
+    PlaneInfo planes[VIDEO_MAX_PLANES];  // 单平面缓冲区只用 planes[0]
+    int64_t dequeued_ns;  // 最近一次出队的时间，用于统计缓冲区在用户态停留多久
+};
+
+// mmap 缓冲区环。由 Camera 和所有未归还的 FrameLease 共同持有，
+// 最后一个引用消失时才 munmap，因此租约可以安全地比 Camera 活得更久
+struct BufferRing {
+    int fd = -1;
+    int notify_fd = -1;             // 归还缓冲区后写入的 eventfd，唤醒等待中的采集线程
+    uint32_t type = V4L2_BUF_TYPE_VIDEO_CAPTURE;  // 或 V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE
+    unsigned int mem_planes = 1;    // 每个缓冲区的内存平面数
+    BufferInfo* buffers = nullptr;  // 缓冲区数组
+    unsigned int buffer_count = 0;  // 缓冲区数量
+    bool streaming = false;         // 为 false 时不再向驱动归还缓冲区
+    unsigned int leased = 0;        // 已借出尚未归还的缓冲区数
+    unsigned int peak_leased = 0;   // 统计窗口内同时借出的最大数量
+    int64_t held_ns_max = 0;        // 统计窗口内缓冲区在用户态停留的最长时间
+    std::mutex ring_mutex;
+
+    BufferRing() = default;
+    BufferRing(const BufferRing&) = delete;
+    BufferRing& operator=(const BufferRing&) = delete;
+    ~BufferRing() {
         if (buffers) {
             for (unsigned int i = 0; i < buffer_count; ++i) {
-                if (buffers[i].start != MAP_FAILED && buffers[i].start != nullptr) {
-                    munmap(buffers[i].start, buffers[i].length);
+                for (unsigned int p = 0; p < mem_planes; ++p) {
+                    PlaneInfo& plane = buffers[i].planes[p];
+                    if (plane.start != MAP_FAILED && plane.start != nullptr) {
+                        munmap(plane.start, plane.length);
+                    }
                 }
             }
             free(buffers);
             buffers = nullptr;
         }
     }
-    std::mutex cam_mutex; // 新增互斥锁
+    bool multiplanar() const { return type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE; }
+    // 租约释放时调用：把缓冲区重新入队
+    void requeue(unsigned int index);
+};
+
+// 调用方对采集模式的偏好
+struct CapturePreference {
+    int width = 640;
+    int height = 480;
+    double fps = 30.0;
+    uint32_t pixelformat = 0;  // 0 表示自动：能满足帧率时优先 YUYV，否则 MJPEG
+    unsigned int buffer_count = 4;  // mmap 缓冲区数量（驱动可能调整）
+    // 自动调节：根据丢帧率和缓冲区在用户态的停留时间增减缓冲区，
+    // 在 min_buffers..max_buffers 之间以尽量少的内存维持 target_drop_rate
+    bool auto_buffers = false;
+    unsigned int min_buffers = 2;
+    unsigned int max_buffers = 16;
+    double target_drop_rate = 0.001;
+};
+
+// S_FMT 协商后的帧布局，单平面和多平面 API 统一表示
+struct FrameLayout {
+    int width = 0;
+    int height = 0;
+    uint32_t pixelformat = 0;
+    unsigned int mem_planes = 1;              // 每个缓冲区的内存平面数（NV12M 为 2，NV12 为 1）
+    size_t stride[VIDEO_MAX_PLANES] = {};     // 各内存平面的行字节数
+};
+
+// 设备支持的一种采集模式
+struct CaptureMode {
+    uint32_t pixelformat = 0;
+    int width = 0;
+    int height = 0;
+    double max_fps = 0.0;  // 该分辨率下能达到的最高帧率
+};
+
+// V4L2 摄像头帧源
+class Camera : public FrameSource {
+    std::string device_path;
+    int fd;
+    struct v4l2_format fmt;
+    struct v4l2_buffer buf;
+    uint32_t buf_type = V4L2_BUF_TYPE_VIDEO_CAPTURE;  // 设备只支持多平面 API 时为 _MPLANE
+    FrameLayout layout;            // 由 fmt 整理出的帧布局
+    std::shared_ptr<BufferRing> ring;  // 缓冲区环（与租约共享）
+    unsigned int current_buffer;  // 当前处理的缓冲区索引
+    // 清理缓冲区的辅助函数：停止归还，映射在最后一个租约释放后解除
+    void cleanup_buffers() {
+        if (ring) {
+            std::lock_guard<std::mutex> lock(ring->ring_mutex);
+            ring->streaming = false;
+        }
+        ring.reset();
+    }
+    std::mutex cam_mutex; // 只保护 DQBUF 本身，等待期间不持有
+    int epoll_fd;                  // 监听设备可读和 wake_fd
+    int wake_fd;                   // eventfd：停止/命令信号，以及缓冲区归还通知
+    std::atomic<bool> wakeup_pending{false};  // wake() 被调用过，等待中的 acquire_frame 应立即返回
+    // 创建 epoll 和 eventfd
+    bool setup_event_loop();
+    // 只在 wake_fd 上等待到 deadline，用于设备暂不可用（例如所有缓冲区都被借出）时
+    void wait_for_wake(std::chrono::steady_clock::time_point deadline);
+    // 非阻塞地出队一帧，没有就绪帧时返回 false 且 errno 为 EAGAIN
+    bool dequeue(FrameLease& lease);
+    // 丢帧检测：驱动序号出现缺口说明传感器/总线侧丢了帧，与我们自己的队列无关
+    bool have_sequence = false;           // 本次 STREAMON 之后是否见过序号
+    uint32_t last_sequence = 0;
+    std::atomic<uint64_t> driver_drops{0};  // 序号缺口累计的丢帧数
+    std::atomic<uint64_t> error_frames{0};  // 带 V4L2_BUF_FLAG_ERROR 的帧（数据可能损坏）
+    // 缓冲区深度自动调节：按窗口统计，需要调整时记下目标深度，
+    // 等所有租约归还后在采集线程里 REQBUFS 重建
+    uint64_t window_frames = 0;
+    uint64_t window_drops = 0;
+    unsigned int pending_buffer_count = 0;  // 0 表示不需要调整
+    void evaluate_ring_depth();
+    void apply_ring_depth();
+    // REQBUFS + mmap + QBUF + STREAMON，成功后 ring 指向新环
+    bool start_streaming(unsigned int count);
+    // STREAMOFF 并释放驱动侧缓冲区（REQBUFS count=0）；调用前映射必须都已解除
+    void stop_streaming();
+    CapturePreference preference;  // 调用方的偏好
+    double actual_fps;             // 驱动实际接受的帧率
+    // 通过 ENUM_FMT / ENUM_FRAMESIZES / ENUM_FRAMEINTERVALS 协商并设置格式
+    bool negotiate_format();
     public:
         Camera();
         Camera(const char* device_path);
         Camera(const std::string& device_path);
+        Camera(const std::string& device_path, const CapturePreference& preference);
         Camera(const Camera&) = delete; // 禁止拷贝构造函数
         Camera& operator=(const Camera&) = delete; // 禁止赋值操作符重载
-        ~Camera();
-        void capture_frame(cv::Mat& frame);
+        ~Camera() override;
+        // 出队一帧并以租约形式交出 mmap 缓冲区（零拷贝），失败返回 false
+        bool acquire_frame(FrameLease& lease, int timeout_ms = 2000) override;
+        // 唤醒 acquire_frame 中的等待（写 eventfd），可以从任何线程调用
+        void wake() override;
+        // 当前借出未归还的缓冲区数
+        unsigned int leased_buffers();
         void init_v4l2();
-        void initFrame(cv::Mat& frame);
+        void initFrame(cv::Mat& frame) override;
+        int width() const override { return layout.width; }
+        int height() const override { return layout.height; }
+        uint32_t pixel_format() const override { return layout.pixelformat; }
+        bool is_open() const override { return fd >= 0 && ring != nullptr; }
+        double fps() const { return actual_fps; }
+        unsigned int ring_depth() const { return ring ? ring->buffer_count : 0; }
+        uint64_t dropped_frames() const override { return driver_drops.load(); }
+        uint64_t corrupted_frames() const { return error_frames.load(); }
+        // 列出设备支持且我们能解码的全部采集模式
+        std::vector<CaptureMode> supported_modes();
 };
 
 
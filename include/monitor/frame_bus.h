@@ -0,0 +1,103 @@
+#ifndef FRAME_BUS_H
+#define FRAME_BUS_H
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "frame_lease.h"
+#include "frame_queue.h"
+#include "frame_mailbox.h"
+#include "yuv_convert.h"
+
+// 订阅者取帧的方式
+enum class DeliveryMode {
+    Queue,   // 按顺序逐帧消费（录制、分析），满时按 policy 处理
+    Latest,  // 只要最新一帧（显示），三缓冲信箱，发布方从不等待
+};
+
+// 订阅参数
+struct SubscriberOptions {
+    DeliveryMode mode = DeliveryMode::Queue;
+    size_t queue_depth = 8;                 // Queue 模式的队列容量
+    PixelLayout format = PixelLayout::BGR;  // 需要的像素排列
+    double max_fps = 0.0;                   // 按采集时间戳抽帧到此帧率，0 表示每帧都要
+    BackpressurePolicy policy = BackpressurePolicy::DropOldest;
+    int block_timeout_ms = 100;
+};
+
+// 订阅者统计
+struct SubscriberStats {
+    QueueStats queue;        // Queue 模式的队列统计
+    uint64_t delivered = 0;  // 交付的帧数
+    uint64_t decimated = 0;  // 按 max_fps 跳过的帧数
+    uint64_t overwritten = 0;  // Latest 模式下没被看到就被新帧覆盖的帧数
+};
+
+// 一个订阅者的接收端。发布方（采集线程）是唯一的生产者，订阅者自己的线程是唯一的消费者
+class FrameSubscription {
+    friend class FrameBus;
+    std::string name;
+    SubscriberOptions options;
+    FrameQueue queue;
+    TripleBuffer<TimedFrame> mailbox;
+    bool has_latest = false;           // 消费者是否已经从信箱取到过帧
+    int64_t next_due_ns = 0;           // 下一帧的最早采集时间（抽帧用，只由发布方访问）
+    std::atomic<uint64_t> delivered{0};
+    std::atomic<uint64_t> decimated{0};
+
+    // 发布方：按帧率抽帧，需要这一帧时返回 true
+    bool due(int64_t capture_ns);
+    // 发布方：取得要写的槽位，队列按策略丢弃时返回 nullptr
+    TimedFrame* begin_delivery();
+    void finish_delivery();
+public:
+    FrameSubscription(const std::string& name, const SubscriberOptions& options);
+    FrameSubscription(const FrameSubscription&) = delete;
+    FrameSubscription& operator=(const FrameSubscription&) = delete;
+
+    const std::string& get_name() const { return name; }
+    const SubscriberOptions& get_options() const { return options; }
+
+    // Queue 模式
+    TimedFrame* wait_front(std::chrono::milliseconds timeout) { return queue.wait_front(timeout); }
+    TimedFrame* front() { return queue.front(); }
+    void pop() { queue.pop(); }
+    void wake() { queue.wake(); }
+    size_t size() const { return queue.size(); }
+    void set_policy(BackpressurePolicy policy, int block_timeout_ms = 100) { queue.set_policy(policy, block_timeout_ms); }
+
+    // Latest 模式：有新帧时换入 latest() 并返回 true
+    bool has_fresh() const { return mailbox.has_fresh(); }
+    bool update();
+    // 最近一次 update() 取到的帧，从未取到过时返回 nullptr
+    TimedFrame* latest() { return has_latest ? &mailbox.front() : nullptr; }
+
+    SubscriberStats stats() const;
+};
+
+// 发布/订阅帧总线。每个订阅者有自己的队列深度、像素格式和帧率；
+// 每帧对每种被请求的格式只转换一次，同格式的订阅者共享同一块像素内存
+class FrameBus {
+    typedef std::vector<std::shared_ptr<FrameSubscription>> SubscriberList;
+    std::mutex subscribers_mutex;  // 只保护列表指针的替换，发布时拿快照后立即释放
+    std::shared_ptr<const SubscriberList> subscribers;
+    std::atomic<uint64_t> conversions{0};
+    std::atomic<uint64_t> generation{0};
+public:
+    FrameBus();
+    // 任意线程：注册订阅者，下一帧开始接收
+    std::shared_ptr<FrameSubscription> subscribe(const std::string& name, const SubscriberOptions& options);
+    // 任意线程：注销订阅者；订阅者对象在最后一个引用消失后才销毁
+    void unsubscribe(const std::shared_ptr<FrameSubscription>& subscription);
+    // 发布方（采集线程）：把一帧分发给所有需要它的订阅者，返回交付的订阅者数
+    size_t publish(const FrameLease& lease);
+    size_t subscriber_count();
+    uint64_t conversion_count() const { return conversions.load(); }
+    // 发布序号：每次 publish 取一个，不经总线的帧（UI 线程直接采集）也从这里取，保证同一序列单调递增
+    uint64_t next_generation() { return ++generation; }
+};
+
+#endif // FRAME_BUS_H
@@ -0,0 +1,193 @@
+#ifndef FRAME_LEASE_H
+#define FRAME_LEASE_H
+
+#include <linux/videodev2.h>
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include "yuv_convert.h"
+
+// CLOCK_MONOTONIC 纳秒，与 V4L2 的单调时间戳及 std::chrono::steady_clock 同源
+inline int64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// 每帧的采集元数据，用于区分卡顿来自传感器/总线（驱动丢帧）还是我们自己的队列
+struct FrameMeta {
+    uint64_t sequence = 0;        // 驱动序号
+    int64_t capture_ns = 0;       // 驱动打的采集时间戳（CLOCK_MONOTONIC）
+    int64_t dequeue_ns = 0;       // 出队时间
+    int64_t convert_ns = 0;       // 颜色转换完成时间，0 表示尚未转换
+    uint32_t flags = 0;           // v4l2_buffer.flags
+    uint32_t dropped_before = 0;  // 与上一帧之间驱动丢掉的帧数（序号差）
+};
+
+// 图像的一个平面
+struct FramePlane {
+    void* data = nullptr;
+    size_t bytesused = 0;
+    size_t stride = 0;        // 每行字节数
+};
+
+// 半平面 YUV（Y 平面 + 交错 UV 平面）；单缓冲区的 NV12/NV16 与多平面的 NV12M/NV16M 都算
+inline bool is_semi_planar(uint32_t pixelformat) {
+    return pixelformat == V4L2_PIX_FMT_NV12 || pixelformat == V4L2_PIX_FMT_NV12M ||
+           pixelformat == V4L2_PIX_FMT_NV16 || pixelformat == V4L2_PIX_FMT_NV16M;
+}
+
+// UV 平面的垂直下采样位数：4:2:0 为 1，4:2:2 为 0
+inline int chroma_shift(uint32_t pixelformat) {
+    return pixelformat == V4L2_PIX_FMT_NV12 || pixelformat == V4L2_PIX_FMT_NV12M ? 1 : 0;
+}
+
+// 一次出队得到的原始帧，data 直接指向驱动的 mmap 缓冲区（不拷贝）
+struct LeasedFrame {
+    void* data = nullptr;     // 第一个平面（打包格式即全部数据），与 planes[0] 相同
+    size_t bytesused = 0;     // 本帧有效字节数
+    size_t stride = 0;        // 每行字节数
+    int width = 0;
+    int height = 0;
+    uint32_t pixelformat = 0; // V4L2_PIX_FMT_*
+    unsigned int index = 0;   // 缓冲区在环中的序号
+    unsigned int num_planes = 1;  // 图像平面数：打包格式 1，NV12/NV16 为 2（无论驱动用几块内存）
+    FramePlane planes[2];
+    FrameMeta meta;
+};
+
+// 帧租约：引用计数地持有一个已出队的缓冲区，
+// 最后一个持有者（显示、录制、拍照……）释放时缓冲区才会重新入队
+class FrameLease {
+    std::shared_ptr<const LeasedFrame> buffer;
+    size_t yuyv_stride() const { return buffer->stride ? buffer->stride : static_cast<size_t>(buffer->width) * 2; }
+public:
+    FrameLease() = default;
+    explicit FrameLease(std::shared_ptr<const LeasedFrame> buffer) : buffer(std::move(buffer)) {}
+
+    bool valid() const { return buffer != nullptr; }
+    explicit operator bool() const { return valid(); }
+    const LeasedFrame* operator->() const { return buffer.get(); }
+    const uint8_t* data() const { return buffer ? static_cast<const uint8_t*>(buffer->data) : nullptr; }
+    long use_count() const { return buffer.use_count(); }
+    const FrameMeta& meta() const { static const FrameMeta empty; return buffer ? buffer->meta : empty; }
+
+    // 零拷贝地包装第 i 个平面（CV_8UC1，UV 平面每行 width 字节）
+    cv::Mat plane(unsigned int i) const {
+        if (!buffer || i >= buffer->num_planes) {
+            return cv::Mat();
+        }
+        const FramePlane& p = buffer->planes[i];
+        int rows = i == 0 ? buffer->height : buffer->height >> chroma_shift(buffer->pixelformat);
+        int cols = i == 0 && buffer->num_planes == 1 ? static_cast<int>(p.stride) : buffer->width;
+        return cv::Mat(rows, cols, CV_8UC1, p.data, p.stride);
+    }
+
+    // 零拷贝地把原始数据包装成 cv::Mat（只读使用，租约释放后失效）
+    cv::Mat raw() const {
+        if (!buffer) {
+            return cv::Mat();
+        }
+        if (is_semi_planar(buffer->pixelformat)) {
+            // 两个平面在内存中相连时给出完整的 (h + h/2) x w 图像，否则只给 Y 平面
+            const uint8_t* y_end = data() + buffer->stride * buffer->height;
+            int rows = buffer->planes[1].data == y_end
+                           ? buffer->height + (buffer->height >> chroma_shift(buffer->pixelformat))
+                           : buffer->height;
+            return cv::Mat(rows, buffer->width, CV_8UC1, buffer->data, buffer->stride);
+        }
+        switch (buffer->pixelformat) {
+        case V4L2_PIX_FMT_YUYV:
+            return cv::Mat(buffer->height, buffer->width, CV_8UC2, buffer->data, buffer->stride);
+        case V4L2_PIX_FMT_BGR24:
+            return cv::Mat(buffer->height, buffer->width, CV_8UC3, buffer->data, buffer->stride);
+        default:
+            return cv::Mat(1, static_cast<int>(buffer->bytesused), CV_8UC1, buffer->data);
+        }
+    }
+
+    // 转换为 BGR 写入调用方提供的 out；尺寸类型一致时复用 out 的内存
+    bool to_bgr(cv::Mat& out) const {
+        if (!buffer) {
+            return false;
+        }
+        if (is_semi_planar(buffer->pixelformat)) {
+            out.create(buffer->height, buffer->width, CV_8UC3);
+            return convert_to(out.data, out.step, PixelLayout::BGR);
+        }
+        switch (buffer->pixelformat) {
+        case V4L2_PIX_FMT_YUYV:
+            out.create(buffer->height, buffer->width, CV_8UC3);
+            yuyv_convert(data(), yuyv_stride(), out.data, out.step, buffer->width, buffer->height, PixelLayout::BGR);
+            return true;
+        case V4L2_PIX_FMT_BGR24:
+            raw().copyTo(out);
+            return true;
+        case V4L2_PIX_FMT_MJPEG:
+            // 交给 OpenCV 的 libjpeg(-turbo) 解码，直接写入 out 的内存；
+            // libjpeg-turbo 能处理 UVC 摄像头省略 Huffman 表的 MJPEG 帧
+            cv::imdecode(raw(), cv::IMREAD_COLOR, &out);
+            return !out.empty();
+        default:
+            return false;
+        }
+    }
+
+    // 重排成 NV12 写入 out（(h*3/2) x w 单通道，Y 在上 UV 在下），只拷贝不做颜色转换；
+    // 仅半平面和 YUYV 源可用，其他格式返回 false。尺寸一致时复用 out 的内存
+    bool to_nv12(cv::Mat& out) const {
+        if (!buffer || buffer->width % 2 != 0 || buffer->height % 2 != 0) {
+            return false;
+        }
+        if (is_semi_planar(buffer->pixelformat)) {
+            const FramePlane& y = buffer->planes[0];
+            const FramePlane& uv = buffer->planes[1];
+            out.create(buffer->height * 3 / 2, buffer->width, CV_8UC1);
+            nv12_from_semi_planar(static_cast<const uint8_t*>(y.data), y.stride,
+                                  static_cast<const uint8_t*>(uv.data), uv.stride,
+                                  out.data, out.step, buffer->width, buffer->height,
+                                  chroma_shift(buffer->pixelformat));
+            return true;
+        }
+        if (buffer->pixelformat == V4L2_PIX_FMT_YUYV) {
+            out.create(buffer->height * 3 / 2, buffer->width, CV_8UC1);
+            nv12_from_yuyv(data(), yuyv_stride(), out.data, out.step, buffer->width, buffer->height);
+            return true;
+        }
+        return false;
+    }
+
+    // 转换写入调用方提供的内存（纹理暂存区、编码器输入等），不做中间分配；NV12 走 to_nv12
+    bool convert_to(uint8_t* dst, size_t dst_stride, PixelLayout layout) const {
+        if (!buffer || layout == PixelLayout::NV12) {
+            return false;
+        }
+        if (buffer->pixelformat == V4L2_PIX_FMT_YUYV) {
+            yuyv_convert(data(), yuyv_stride(), dst, dst_stride, buffer->width, buffer->height, layout);
+            return true;
+        }
+        if (is_semi_planar(buffer->pixelformat)) {
+            const FramePlane& y = buffer->planes[0];
+            const FramePlane& uv = buffer->planes[1];
+            nv_convert(static_cast<const uint8_t*>(y.data), y.stride, static_cast<const uint8_t*>(uv.data), uv.stride,
+                       dst, dst_stride, buffer->width, buffer->height, chroma_shift(buffer->pixelformat), layout);
+            return true;
+        }
+        cv::Mat out(buffer->height, buffer->width, layout == PixelLayout::BGR ? CV_8UC3 : CV_8UC4, dst, dst_stride);
+        if (layout == PixelLayout::BGR) {
+            return to_bgr(out) && out.data == dst;
+        }
+        cv::Mat bgr;
+        if (!to_bgr(bgr)) {
+            return false;
+        }
+        cv::cvtColor(bgr, out, layout == PixelLayout::BGRA ? cv::COLOR_BGR2BGRA : cv::COLOR_BGR2RGBA);
+        return out.data == dst;
+    }
+
+    // 提前归还（析构时也会自动归还）
+    void release() { buffer.reset(); }
+};
+
+#endif // FRAME_LEASE_H
@@ -0,0 +1,56 @@
+#ifndef FRAME_MAILBOX_H
+#define FRAME_MAILBOX_H
+
+#include <atomic>
+#include <cstdint>
+
+// 三缓冲“最新帧”信箱（无锁，单生产者单消费者）。
+// 生产者写 back() 后 publish()，从不等待；消费者 update() 后读 front()，
+// 总能拿到最新一份完整的数据，中间没被看到的旧数据直接被覆盖。
+// 三个缓冲区各归一方：生产者的 back、消费者的 front、以及交换用的 middle，
+// 交换只是一次原子 exchange，任何一方都不会被另一方的慢操作拖住
+template <typename T>
+class TripleBuffer {
+    static constexpr uint8_t kIndexMask = 3;
+    static constexpr uint8_t kFresh = 4;  // middle 中有消费者尚未取走的新数据
+
+    T buffers[3];
+    alignas(64) std::atomic<uint8_t> middle{1};
+    alignas(64) uint8_t back_index = 0;     // 只由生产者访问
+    std::atomic<uint64_t> overwritten_count{0};
+    alignas(64) uint8_t front_index = 2;    // 只由消费者访问
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // 生产者：当前可写的缓冲区（保留上次写入的内容，可复用其内存）
+    T& back() { return buffers[back_index]; }
+    // 生产者：发布 back()，换回一块空闲缓冲区
+    void publish() {
+        uint8_t previous = middle.exchange(static_cast<uint8_t>(back_index | kFresh), std::memory_order_acq_rel);
+        if (previous & kFresh) {
+            overwritten_count.fetch_add(1, std::memory_order_relaxed);  // 上一份还没被看到就被取代
+        }
+        back_index = previous & kIndexMask;
+    }
+
+    // 消费者：是否有尚未取走的新数据
+    bool has_fresh() const { return (middle.load(std::memory_order_acquire) & kFresh) != 0; }
+    // 消费者：有新数据时换到 front() 并返回 true
+    bool update() {
+        if (!has_fresh()) {
+            return false;
+        }
+        uint8_t previous = middle.exchange(front_index, std::memory_order_acq_rel);
+        front_index = previous & kIndexMask;
+        return true;
+    }
+    // 消费者：最近一次 update() 取到的数据
+    T& front() { return buffers[front_index]; }
+
+    // 发布后未被消费者看到就被覆盖的次数（显示跟不上采集的程度）
+    uint64_t overwritten() const { return overwritten_count.load(std::memory_order_relaxed); }
+};
+
+#endif // FRAME_MAILBOX_H
@@ -0,0 +1,86 @@
+#ifndef FRAME_QUEUE_H
+#define FRAME_QUEUE_H
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include "frame_lease.h"
+#include "spsc_ring.h"
+
+// 带采集元数据的已转换帧
+struct TimedFrame {
+    cv::Mat image;   // BGR
+    FrameMeta meta;
+    uint64_t generation = 0;  // 发布序号，单调递增；0 表示未经总线发布
+};
+
+// 消费者队列满时的处理策略
+enum class BackpressurePolicy {
+    DropOldest,         // 丢掉最旧的未读帧，保留最新的
+    DropNewest,         // 丢掉新来的帧，已排队的帧不受影响
+    BlockWithDeadline,  // 生产者最多等待 block_timeout_ms，仍然满才丢新帧（会拖慢采集线程）
+    Decimate,           // 积压超过一半时均匀抽帧（每 2 帧或 4 帧留 1 帧），保持节奏而不是成段丢失
+};
+
+const char* backpressure_policy_name(BackpressurePolicy policy);
+
+// 消费者队列的统计，用来按数据确定硬件和队列大小
+struct QueueStats {
+    uint64_t pushed = 0;          // 成功入队的帧
+    uint64_t dropped = 0;         // 按策略丢掉的帧（含被淘汰的旧帧和被抽掉的帧）
+    size_t depth = 0;             // 当前排队帧数
+    size_t high_water = 0;        // 排队帧数的历史最大值
+    size_t bytes_buffered = 0;    // 当前排队帧占用的像素字节数
+    size_t capacity = 0;
+};
+
+// 单生产者单消费者的帧队列：SpscRing 加上满队列策略、统计和等待/唤醒
+class FrameQueue {
+    SpscRing<TimedFrame> ring;
+    std::atomic<BackpressurePolicy> policy;
+    std::atomic<int> block_timeout_ms;
+    std::mutex wait_mutex;              // 只用于睡眠和唤醒，不保护数据
+    std::condition_variable data_cv;    // 生产者发布了新帧
+    std::condition_variable space_cv;   // 消费者归还了槽位
+    std::atomic<bool> woken{false};
+    TimedFrame* pending = nullptr;      // 生产者正在写的槽位
+    uint64_t decimate_counter = 0;      // 只由生产者访问
+    std::atomic<uint64_t> pushed_count{0};
+    std::atomic<uint64_t> dropped_count{0};
+    std::atomic<size_t> high_water{0};
+    std::atomic<size_t> bytes_buffered{0};
+
+    static size_t frame_bytes(const TimedFrame& frame) { return frame.image.total() * frame.image.elemSize(); }
+    void notify(std::condition_variable& cv);
+    TimedFrame* drop();
+public:
+    explicit FrameQueue(size_t capacity, BackpressurePolicy policy = BackpressurePolicy::DropOldest,
+                        int block_timeout_ms = 100);
+    FrameQueue(const FrameQueue&) = delete;
+    FrameQueue& operator=(const FrameQueue&) = delete;
+
+    // 可以在运行中切换，下一帧生效
+    void set_policy(BackpressurePolicy policy, int block_timeout_ms = 100);
+    BackpressurePolicy get_policy() const { return policy.load(); }
+
+    // 生产者：按策略取得可写槽位，返回 nullptr 表示这一帧被丢弃（已计数）
+    TimedFrame* begin_push();
+    // 生产者：发布 begin_push() 返回的槽位并唤醒消费者
+    void commit_push();
+
+    // 消费者：认领队首，空时返回 nullptr
+    TimedFrame* front() { return ring.front(); }
+    // 消费者：等到有帧、超时或 wake()，没有帧时返回 nullptr
+    TimedFrame* wait_front(std::chrono::milliseconds timeout);
+    // 消费者：归还 front() 认领的槽位
+    void pop();
+    // 唤醒等待中的消费者（停止时使用）
+    void wake();
+
+    size_t size() const { return ring.size(); }
+    QueueStats stats() const;
+};
+
+#endif // FRAME_QUEUE_H
@@ -0,0 +1,71 @@
+#ifndef FRAME_SOURCE_H
+#define FRAME_SOURCE_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <condition_variable>
+#include "frame_lease.h"
+
+// 帧源接口：真实摄像头、合成信号、录像回放都实现它，
+// Monitor 只依赖这个接口，因此可以在没有摄像头的机器上跑完整流水线
+class FrameSource {
+    std::mutex wake_mutex;
+    std::condition_variable wake_cv;
+    bool wake_requested = false;
+protected:
+    // 可被 wake() 打断的睡眠，被打断时返回 false
+    bool sleep_until(std::chrono::steady_clock::time_point deadline);
+public:
+    virtual ~FrameSource() = default;
+    // 让正在 acquire_frame 中等待的线程立即返回 false（用于停止采集线程或投递命令）
+    virtual void wake();
+    // 取得一帧（租约形式），超时或失败返回 false
+    virtual bool acquire_frame(FrameLease& lease, int timeout_ms = 2000) = 0;
+    // 用于初始化纹理的第一帧（BGR）
+    virtual void initFrame(cv::Mat& frame) = 0;
+    virtual int width() const = 0;
+    virtual int height() const = 0;
+    virtual uint32_t pixel_format() const = 0;  // V4L2_PIX_FMT_*
+    virtual bool is_open() const = 0;
+    // 帧源一侧丢掉的帧数（驱动序号缺口、缓冲区耗尽等）
+    virtual uint64_t dropped_frames() const { return 0; }
+
+    // 取一帧并转换为 BGR，总是写入新内存
+    void capture_frame(cv::Mat& frame);
+};
+
+// 根据描述字符串创建帧源：
+//   "synthetic:640x480@30,yuyv,jitter=2"  合成信号（格式 yuyv/mjpeg/bgr/nv12，抖动单位毫秒）
+//   "replay:path/to/file.mp4[,max][,loop]" 回放录像（默认按原速，max 为全速）
+//   "v4l2:/dev/video0,1920x1080@30,mjpeg"  摄像头并指定采集偏好（格式 yuyv/mjpeg/nv12/nv16，省略为自动）
+//   "v4l2:/dev/video0,buffers=8"           指定缓冲区数量，"buffers=auto" 为自动调节
+//   其它字符串视为 V4L2 设备路径
+FrameSource* create_frame_source(const std::string& uri);
+
+// 固定数量的帧缓冲区池，供非 V4L2 帧源发放租约。
+// 池状态由租约共享持有，租约可以比帧源活得更久
+class LeaseBufferPool {
+    struct State {
+        std::vector<cv::Mat> slots;
+        std::vector<unsigned int> free_slots;
+        std::mutex pool_mutex;
+    };
+    std::shared_ptr<State> state;
+public:
+    LeaseBufferPool(unsigned int count, int rows, int cols, int type);
+    // 取一个空闲槽位，全部借出时返回 false
+    bool take(unsigned int& index);
+    // 槽位的存储，生产者在 lease() 之前写入
+    cv::Mat& slot(unsigned int index);
+    // 把槽位包装成租约，最后一个持有者释放时槽位回到空闲列表；
+    // width/height 为 0 时取槽位尺寸（压缩格式的槽位只是一段字节）
+    FrameLease lease(unsigned int index, uint32_t pixelformat, size_t bytesused,
+                     int width = 0, int height = 0, const FrameMeta& meta = FrameMeta());
+    unsigned int free_count();
+};
+
+#endif // FRAME_SOURCE_H
@@ -0,0 +1,65 @@
+#ifndef MKV_WRITER_H
+#define MKV_WRITER_H
+
+#include <opencv2/opencv.hpp>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// 按采集时间戳写视频：每帧压成 JPEG，以毫秒精度的真实时间戳写入 Matroska（V_MJPEG）。
+// cv::VideoWriter 假定帧间隔恒为 1/fps，低光照降帧或采集线程追赶时回放会快慢不一；
+// 这里每帧带自己的时间戳，回放时长与采集时长一致，也不需要重复帧来凑帧率。
+// 每帧都是关键帧，约每秒一个 Cluster，结束时写索引（Cues），可以随意拖动。
+// 所有方法只由录制线程调用
+class MkvWriter {
+    struct CuePoint {
+        int64_t time_ms;
+        uint64_t cluster_pos;  // 相对 Segment 数据起点
+    };
+
+    std::ofstream file;
+    std::string path;
+    int width = 0;
+    int height = 0;
+    double fps = 30.0;  // 只用来定最后一帧的时长
+    std::vector<int> jpeg_params;
+    std::vector<uchar> jpeg;
+
+    uint64_t segment_size_pos = 0;  // 结束时回填的位置
+    uint64_t segment_data_pos = 0;
+    uint64_t seek_head_pos = 0;
+    uint64_t duration_pos = 0;
+    uint64_t info_pos = 0;
+    uint64_t tracks_pos = 0;
+
+    std::vector<uint8_t> cluster;  // 当前 Cluster 的内容，满一秒后整块写出
+    int64_t cluster_ms = -1;
+    std::vector<CuePoint> cues;
+    int64_t origin_ns = 0;  // 第一帧的采集时间，时间戳从 0 开始
+    int64_t last_ms = -1;
+    uint64_t frame_count = 0;
+
+    void write_header();
+    void flush_cluster();
+public:
+    MkvWriter() = default;
+    MkvWriter(const MkvWriter&) = delete;
+    MkvWriter& operator=(const MkvWriter&) = delete;
+    ~MkvWriter();
+
+    bool open(const std::string& path, const cv::Size& size, double fps = 30.0, int quality = 90);
+    // 写入一帧（BGR），capture_ns 为采集时间（monotonic），为 0 时取当前时间；
+    // 时间戳不增时顺延 1ms，保证严格递增
+    bool write(const cv::Mat& frame, int64_t capture_ns);
+    // 写出剩余数据、索引，回填时长和头部；返回文件是否完整写出
+    bool close();
+    bool isOpened() const { return file.is_open(); }
+
+    uint64_t frames() const { return frame_count; }
+    // 最后一帧按标称帧率计时长：用最后一次间隔的话，采集停顿之后的一帧会把整段停顿算进总时长
+    int64_t duration_ms() const { return last_ms < 0 ? 0 : last_ms + std::llround(1000.0 / fps); }
+};
+
+#endif // MKV_WRITER_H
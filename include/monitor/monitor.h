@@ -10,6 +10,18 @@
 #include <imgui.h>
 #include <GL/gl.h>
 #include "camera.h"
+#include "frame_bus.h"
+#include "texture_uploader.h"
+#include "segmented_encoder.h"
+#include "rolling_recorder.h"
+#include "video_sink.h"
+#include "preroll_buffer.h"
+#include "motion_detector.h"
+#include "mkv_writer.h"
+#include "recording_index.h"
+#include "playback_engine.h"
+#include "photo_encoder.h"
+#include "burst_capture.h"
 #include <string>
 #include <thread>  // 添加线程支持
 #include <atomic>  // 添加原子变量支持
@@ -19,6 +31,7 @@
 
 #include <string>
 #include <chrono>
+#include <functional>
 #include <vector>
 
 struct RecordInfo {
@@ -27,20 +40,50 @@ struct RecordInfo {
     std::chrono::system_clock::time_point end_time;
 };
 
+// 录制编码方式
+enum class RecordingMode {
+    Single,     // 一个 VideoWriter，录制线程逐帧编码
+    Segmented,  // 切成短段在线程池上并行编码，结束时按顺序拼接（见 SegmentedEncoder）
+    Rolling,    // 7x24 连续录制成固定时长的一串文件，旧文件按保留策略删除（见 RollingRecorder）
+    Vfr,        // 按每帧的采集时间戳写入 .mkv，降帧时回放时长仍与实际一致（见 MkvWriter）
+};
+
+// 界面按需渲染的节奏：有输入或新帧时不超过 target_fps，没有事件时按 min_refresh_hz 重画（动画、无信号计时）
+struct RefreshOptions {
+    double target_fps = 60.0;
+    double min_refresh_hz = 2.0;
+};
+
+// 丢帧统计：分别记录帧源一侧（传感器/总线/驱动）和我们自己丢掉的帧
+struct CaptureStats {
+    uint64_t source_drops = 0;   // 帧源报告的丢帧（驱动序号缺口等）
+    uint64_t decimated = 0;      // 按 grabbing_fps 抽掉的帧
+    uint64_t queue_drops = 0;    // 录制队列按背压策略丢掉的帧
+};
+
 class Monitor {
-    std::string device_path;
-    Camera* camera;
-    GLuint textureID;
-    void init_texture(int width, int height);
-    void update_texture(const cv::Mat& frame);
+    std::string device_path;  // 设备路径或帧源描述，见 create_frame_source
+    FrameSource* camera;
+    TextureUploader uploader;  // 经像素缓冲对象异步上传显示帧
+    void update_texture(const cv::Mat& frame, uint64_t generation = 0);
+    // UI 线程直接从帧源采集到 frame，并取一个新的发布序号（只用于没有界面的 capture()）
+    void capture_into_frame();
+    // 预览：界面可见时采集线程一直运行，UI 线程只读显示信箱，从不访问设备
+    double preview_fps = 30.0;
+    int64_t last_frame_ns = 0;   // UI 线程最近一次取到新帧的时间（monotonic_ns）
+    int stale_after_ms = 1000;   // 超过这么久没有新帧就显示无信号
+    RefreshOptions refresh_options;
+    bool is_feed_stale() const;
     
     void display_camera_frame(const cv::Mat& frame);// 显示摄像头图像
-    void takephoto();
     void record();// 录制视频
 
     RecordInfo record_info_temp; // 录制信息
-    std::queue<RecordInfo> record_info_queue;
-    std::mutex record_info_mutex; // 保护队列并发访问
+    // 录制完成（滚动录制是每个分段关闭）时登记到持久化索引，重启后仍可按时间查询；
+    // 索引文件在第一次登记或查询时才打开
+    std::shared_ptr<RecordingIndex> record_index = std::make_shared<RecordingIndex>("recordings.idx");
+    uint32_t camera_id = 0;
+    void register_recording(const RecordInfo& info);
 
     // 异步录制所需的成员变量
     std::thread recording_thread;
@@ -50,39 +93,114 @@ class Monitor {
     int video_codec;
     double video_fps;
     
-    std::mutex frame_mutex;
-    std::queue<cv::Mat> frame_queue;
-    std::condition_variable frame_cv;
+    // 采集线程把每帧发布到总线，显示、录制等消费者各自订阅
+    FrameBus bus;
+    // 显示：最新帧信箱，采集线程发布从不等待，UI 总取最新一帧；
+    // 订阅 BGRA，纹理上传只是一次顺序拷贝
+    std::shared_ptr<FrameSubscription> display_sub;
+    // UI 线程：有新帧时从信箱取到 frame / frame_meta
+    bool take_latest_frame();
+    // 录制：每次录制开始时订阅（单生产者单消费者队列，槽位内存循环复用），满时按策略处理
+    std::shared_ptr<FrameSubscription> record_sub;
+    BackpressurePolicy record_policy = BackpressurePolicy::DropOldest;
+    int record_block_timeout_ms = 100;
+    std::atomic<uint64_t> decimated_frames{0};
+    // 下次录制开始时生效
+    RecordingMode recording_mode = RecordingMode::Single;
+    SegmentedEncoderOptions segment_options;
+    RollingOptions rolling_options;
+    // 帧源是 YUYV/NV12/NV16 且有 ffmpeg 时，录制订阅 NV12 直接交给编码器，不经 BGR；
+    // 可变帧率录制写 MJPEG，JPEG 编码要 BGR，仍订阅 BGR。下次开始录制时生效
+    bool nv12_recording = true;
+    bool recording_nv12 = false;  // 本次录制是否送 NV12，开始录制时决定
+    // 当前录制方式对应的文件扩展名
+    std::string recording_extension() const { return recording_mode == RecordingMode::Vfr ? ".mkv" : ".mp4"; }
+    // 录制前回溯：持续保留最近 preroll_seconds 秒（JPEG），开始录制时先写入。
+    // 默认关闭：开着就一直多一个 JPEG 压缩线程和每帧一次 BGR 转换，不录制也一样
+    std::unique_ptr<PrerollBuffer> preroll;
+    double preroll_seconds = 0.0;
+    int preroll_quality = 80;
+    // 录制线程：写入发布序号早于 generation 的回溯帧，返回第一帧的采集时间，没有写入时返回 0
+    int64_t flush_preroll(uint64_t generation, const cv::Size& size,
+                          const std::function<void(const TimedFrame&)>& write_frame);
+    
+    // 移动侦测：采集线程在转换前直接用 Y 采样分析，控制线程据此自动开始/停止录制
+    MotionDetector motion;
+    std::atomic<bool> motion_enabled{false};
+    std::thread motion_thread;
+    std::atomic<bool> stop_motion{false};
+    bool motion_recording = false;        // 当前录制是否由移动侦测发起，只由控制线程访问
+    std::mutex recording_control_mutex;   // 串行化界面和移动侦测对录制的开始/停止
+    // 移动侦测在锁外等录制线程写完（分段拼接可能要几秒），期间界面的录制按钮不阻塞、也不能开始新录制
+    std::atomic<bool> recording_stopping{false};
+    // 持 recording_control_mutex 调用：通知录制线程结束，返回 true 时由调用者在锁外调用 finish_stop_recording
+    bool begin_stop_recording_locked();
+    void finish_stop_recording();
+    void motion_worker();
+    
+    // 拍照：当前帧交给编码线程池，界面只显示最近一次的结果
+    PhotoOptions photo_options;
+    std::mutex photo_status_mutex;
+    std::string photo_status;  // 受 photo_status_mutex 保护
+    std::unique_ptr<PhotoEncoder> photos;
+    
+    // 连拍：作为总线订阅者逐帧保留，收集期间采集线程不抽帧，按传感器全帧率发布
+    std::unique_ptr<BurstCapture> burst;
+    BurstOptions burst_options;
+    size_t burst_frames = 60;  // 界面按钮一次连拍的帧数
+    
+    // 录像回放：打开时显示回放帧（同一条纹理上传路径），预览采集在不录制时停下
+    PlaybackEngine playback;
+    void playback_controls();
     
     // 录制线程的工作函数
     void recording_worker();
 
-    // 计算帧之间的时间间隔（微秒）
-    int64_t frame_interval_us = static_cast<int64_t>(1000000.0 / grabbing_fps);
-    
-    // 用于帧率控制的时间点
-    std::chrono::time_point<std::chrono::high_resolution_clock> next_frame_time;
-
     // 异步视频帧采集所需的成员变量
     std::thread frame_grabber_thread;
+    // 界面、录制和移动侦测线程都会启动/停止采集，由这把锁串行化
+    std::mutex grabber_mutex;
     std::atomic<bool> is_frame_grabbing{false};
     std::atomic<bool> stop_frame_grabbing{false};
     double grabbing_fps; // 期望的视频帧采集帧率
     
     // 异步视频帧采集线程的工作函数
     void frame_grabber_worker();
+    // 没在采集时以 fps 启动；已在采集时不打断
+    void ensure_frame_grabbing(double fps);
+    void start_grabber_locked(double fps);  // 需持有 grabber_mutex
+    void stop_grabber_locked();             // 需持有 grabber_mutex
+    // 显示信箱收到新帧后由采集线程调用（例如唤醒 UI 主循环）
+    std::atomic<void (*)()> frame_notifier{nullptr};
 
 public:
-    cv::Mat frame;
+    cv::Mat frame;         // 当前显示的帧，只由 UI 线程读写
+    FrameMeta frame_meta;  // frame 对应的采集元数据
+    uint64_t frame_generation = 0;  // frame 的发布序号，显示时据此跳过重复上传
     Monitor(const char* device_path = "/dev/video0");
     Monitor(const std::string& device_path);
+    Monitor(FrameSource* source);  // 接管 source 的所有权
     void init();
     void capture();// 捕获一帧图像
     void update();// 更新纹理
     void destroy();// 释放资源，后需init
     void display();// 显示摄像头图像
     void display_dynamic();
+    // 界面不可见（最小化）时调用：不在录制、移动侦测或连拍时停掉预览采集，下次 display_dynamic() 自动恢复
+    void stop_preview();
+    void set_stale_timeout(int ms) { stale_after_ms = ms; }
+    // 主循环每次等待前读取，可随时修改；非正数保持原值
+    void set_refresh_options(const RefreshOptions& options) {
+        if (options.target_fps > 0.0) refresh_options.target_fps = options.target_fps;
+        if (options.min_refresh_hz > 0.0) refresh_options.min_refresh_hz = options.min_refresh_hz;
+    }
+    const RefreshOptions& get_refresh_options() const { return refresh_options; }
+    // 新帧通知，在采集线程上调用，必须可以跨线程调用且不阻塞（如 glfwPostEmptyEvent）
+    void set_frame_notifier(void (*notify)()) { frame_notifier = notify; }
     ~Monitor() {
+        // 先停移动侦测，它会自己开始/停止录制
+        disable_motion_recording();
+        
         // 停止异步视频帧采集
         stop_frame_grabbing_function();
             
@@ -115,7 +233,69 @@ public:
     void stop_frame_grabbing_function();
     bool is_frame_grabbing_active() const;
     bool get_latest_recorded_frame(cv::Mat& out_frame);
+    CaptureStats get_capture_stats() const;
+    // 录制队列满时的处理策略，可在录制中切换
+    void set_recording_backpressure(BackpressurePolicy policy, int block_timeout_ms = 100);
+    QueueStats get_recording_queue_stats() const;
+    // 录制编码方式，下次开始录制时生效
+    void set_recording_mode(RecordingMode mode, const SegmentedEncoderOptions& options = SegmentedEncoderOptions()) {
+        recording_mode = mode;
+        segment_options = options;
+    }
+    // 录制前回溯的时长，0（默认）关闭；录制中调用无效
+    void set_preroll(double seconds, int quality = 80);
+    PrerollStats get_preroll_stats() const { return preroll ? preroll->stats() : PrerollStats(); }
+    // 移动触发录制：有移动时自动开始录制（含 options.preroll_seconds 的回溯），
+    // 移动停止 hold_seconds 后自动停止；需要 YUYV/NV12/NV16 帧源
+    void enable_motion_recording(const MotionOptions& options = MotionOptions());
+    void disable_motion_recording();
+    bool is_motion_recording_enabled() const { return motion_enabled; }
+    MotionStats get_motion_stats() const { return motion.stats(); }
+    // 滚动录制：每个分段关闭时登记到录制索引，被保留策略删除时从索引中去掉
+    void set_rolling_recording(const RollingOptions& options) {
+        recording_mode = RecordingMode::Rolling;
+        rolling_options = options;
+    }
+    const UploadStats& get_upload_stats() const { return uploader.stats(); }
+    // UI 线程：拍下此刻显示的那一帧（不再读设备），立即返回；
+    // 编码和写文件在线程池上进行，完成后 done 在编码线程上调用（见 PhotoEncoder::submit）
+    std::future<PhotoResult> takephoto(std::function<void(const PhotoResult&)> done = nullptr);
+    // 照片参数；会等已提交的照片写完
+    void set_photo_options(const PhotoOptions& options);
+    PhotoStats get_photo_stats() const { return photos ? photos->stats() : PhotoStats(); }
+    // 连拍接下来的 frames 帧（传感器全帧率，不拷贝、不丢帧），收齐后并行编码成图像序列；
+    // 立即返回，进度见 get_burst_progress()。上一次连拍还没写完时返回 false
+    bool start_burst(size_t frames, const BurstOptions& options = BurstOptions());
+    // 把此刻之前的最多 frames 帧编码成图像序列，需先 set_burst_history 常驻保留
+    bool capture_last_frames(size_t frames, const BurstOptions& options = BurstOptions());
+    // 常驻保留最近 frames 帧供 capture_last_frames 取回（占用 frames 帧的 BGR 内存），0 关闭；
+    // 保留期间采集线程按传感器全帧率发布
+    void set_burst_history(size_t frames) { burst->set_history(frames); }
+    BurstProgress get_burst_progress() const { return burst->progress(); }
+    // 界面按钮的连拍帧数和输出参数
+    void set_burst_options(size_t frames, const BurstOptions& options) {
+        burst_frames = frames;
+        burst_options = options;
+    }
+    // 回放一个录像文件，从 start_ms 开始（暂停状态，显示第一帧）
+    bool open_playback(const std::string& filename, int64_t start_ms = 0);
+    // 通过录制索引找到覆盖 time 的录像并定位到该时刻
+    bool open_playback_at(std::chrono::system_clock::time_point time);
+    void close_playback() { playback.close(); }
+    bool is_playback_active() const { return playback.is_open(); }
+    // 回放期间引擎没有新帧通知：播放或等待定位结果时主循环需要按帧率刷新
+    bool playback_needs_refresh() const { return playback.is_open() && playback.needs_refresh(); }
+    // 其他消费者（分析、快照……）通过总线订阅
+    FrameBus& frame_bus() { return bus; }
     
+    // 多个摄像头共用一个索引文件时共享同一个 RecordingIndex，各自用不同的 camera
+    void set_recording_index(std::shared_ptr<RecordingIndex> index, uint32_t camera) {
+        record_index = std::move(index);
+        camera_id = camera;
+    }
+    // 与 [from, to] 有重叠的本摄像头录制，按开始时间排序
+    std::vector<RecordInfo> find_recordings(std::chrono::system_clock::time_point from,
+                                            std::chrono::system_clock::time_point to);
     std::vector<RecordInfo> get_all_record_info();
 };
 
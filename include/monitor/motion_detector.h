@@ -0,0 +1,60 @@
+#ifndef MOTION_DETECTOR_H
+#define MOTION_DETECTOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "frame_lease.h"
+
+// 移动侦测参数
+struct MotionOptions {
+    int grid_width = 80;          // 缩小后的亮度图宽度，高度按比例
+    int pixel_threshold = 20;     // 单元亮度与背景相差超过此值算变化（0-255）
+    double sensitivity = 0.01;    // 变化单元占比超过此值判为有移动
+    double hold_seconds = 5.0;    // 最后一次移动后继续保持的时间
+    double preroll_seconds = 3.0; // 自动录制时包含的触发前时长
+    double background_rate = 0.05;  // 背景模型的更新速度，适应缓慢的光照变化
+};
+
+struct MotionStats {
+    uint64_t frames = 0;         // 分析过的帧
+    uint64_t motion_frames = 0;  // 判为有移动的帧
+    double last_score = 0.0;     // 最近一帧的变化单元占比
+    double avg_cost_us = 0.0;    // 每帧平均耗时（微秒）
+};
+
+// 廉价的移动侦测：直接从 YUYV/NV12/NV16 的 Y 采样得到缩小的亮度图（不做颜色转换），
+// 与缓慢更新的背景做差，变化单元的占比超过灵敏度即判为有移动。
+// 80x60 的网格每帧只读约两万个采样，30fps 下远低于单核的 1%
+class MotionDetector {
+    mutable std::mutex options_mutex;  // process() 与 configure() 之间
+    MotionOptions options;
+    std::vector<uint16_t> background;  // 背景亮度，8.8 定点
+    int grid_w = 0;
+    int grid_h = 0;
+    int warmup = 0;                    // 背景刚建立时不报告移动
+    std::atomic<int64_t> last_motion_ns{0};
+    std::atomic<uint64_t> frame_count{0};
+    std::atomic<uint64_t> motion_count{0};
+    std::atomic<double> last_score{0.0};
+    std::atomic<double> avg_cost_us{0.0};
+    bool warned_format = false;
+public:
+    explicit MotionDetector(const MotionOptions& options = MotionOptions()) : options(options) {}
+
+    // 更新参数并重建背景
+    void configure(const MotionOptions& options);
+    MotionOptions get_options() const;
+
+    // 采集线程：分析一帧，返回这一帧是否有移动；不支持的像素格式（MJPEG 等）返回 false
+    bool process(const FrameLease& lease);
+    // 分析一块亮度数据：y 指向第一个 Y 采样，相邻 Y 采样相隔 pixel_step 字节
+    bool analyse(const uint8_t* y, size_t pixel_step, size_t row_stride, int width, int height, int64_t capture_ns);
+
+    // 任意线程：now_ns 时是否仍处于移动保持期内
+    bool active(int64_t now_ns) const;
+    MotionStats stats() const;
+};
+
+#endif // MOTION_DETECTOR_H
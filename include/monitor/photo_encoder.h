@@ -0,0 +1,83 @@
+#ifndef PHOTO_ENCODER_H
+#define PHOTO_ENCODER_H
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "frame_lease.h"
+
+// 拍照参数
+struct PhotoOptions {
+    std::string directory = ".";
+    std::string prefix = "photo";   // 文件名 <prefix>_YYYYmmdd_HHMMSS_mmm_<序号><extension>
+    std::string extension = ".jpg"; // .jpg 或 .png
+    int jpeg_quality = 95;
+    int png_compression = 3;
+    int workers = 2;
+    size_t max_pending = 32;        // 排队+编码中的照片上限，超出时直接拒绝，不阻塞调用方
+};
+
+// 一张照片的结果
+struct PhotoResult {
+    bool ok = false;
+    std::string path;
+    FrameMeta meta;          // 照片那一帧的采集元数据
+    double encode_ms = 0.0;  // 转换、编码和写文件的耗时
+};
+
+struct PhotoStats {
+    uint64_t saved = 0;
+    uint64_t failed = 0;
+    uint64_t rejected = 0;  // 队列已满被拒绝的
+    size_t pending = 0;
+};
+
+// 异步拍照：调用方交出帧（只增加引用计数，不拷贝像素）立即返回，
+// 颜色转换、JPEG/PNG 编码和写文件在线程池上进行；文件先写临时名再改名，不会看到写了一半的照片
+class PhotoEncoder {
+    struct Job {
+        cv::Mat image;
+        PhotoResult result;
+        std::function<void(const PhotoResult&)> done;
+        std::promise<PhotoResult> promise;
+    };
+
+    PhotoOptions options;
+    std::vector<std::thread> workers;
+    std::mutex jobs_mutex;
+    std::condition_variable jobs_cv;
+    std::deque<Job> jobs;
+    size_t pending = 0;  // 排队+编码中，受 jobs_mutex 保护
+    bool stopping = false;
+    uint64_t counter = 0;  // 文件名序号，受 jobs_mutex 保护
+
+    std::atomic<uint64_t> saved_count{0};
+    std::atomic<uint64_t> failed_count{0};
+    std::atomic<uint64_t> rejected_count{0};
+
+    std::string next_path();  // 需持有 jobs_mutex
+    void worker_loop();
+    bool encode(Job& job);
+public:
+    explicit PhotoEncoder(const PhotoOptions& options = PhotoOptions());
+    PhotoEncoder(const PhotoEncoder&) = delete;
+    PhotoEncoder& operator=(const PhotoEncoder&) = delete;
+    // 等排队的照片全部写完
+    ~PhotoEncoder();
+
+    // 任意线程：提交一帧（BGR/BGRA/灰度），返回照片结果；done 在编码线程上调用。
+    // 队列已满或帧为空时立即得到 ok == false 的结果（done 在调用线程上立即调用）
+    std::future<PhotoResult> submit(const cv::Mat& image, const FrameMeta& meta,
+                                    std::function<void(const PhotoResult&)> done = nullptr);
+    PhotoStats stats();
+};
+
+#endif // PHOTO_ENCODER_H
@@ -0,0 +1,114 @@
+#ifndef PLAYBACK_ENGINE_H
+#define PLAYBACK_ENGINE_H
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 录像的帧索引：每帧的显示时间和所属的关键帧。
+// 建索引只读压缩包、不解码（FFmpeg 原始模式），结果存在录像旁的 .kfi 文件里，
+// 录像的大小或修改时间变了才重建
+struct KeyframeIndex {
+    double fps = 0.0;
+    std::vector<int64_t> pts_ms;        // 每帧的显示时间（毫秒，按显示顺序）
+    std::vector<uint32_t> keyframes;    // 关键帧的帧号，递增
+    std::vector<uint32_t> keyframe_of;  // 每帧之前（含）最近的关键帧，定位时 O(1) 查到从哪里开始解码
+
+    // cancel 置位时放弃（每 64 个包检查一次）并返回 false，索引保持原样
+    bool build(const std::string& video, const std::atomic<bool>* cancel = nullptr);
+    bool load(const std::string& sidecar, const std::string& video);
+    bool save(const std::string& sidecar, const std::string& video) const;
+    size_t frames() const { return pts_ms.size(); }
+    // 显示时间不晚于 ms 的最后一帧
+    uint32_t frame_at(int64_t ms) const;
+    // 不早于 frame 的第一个关键帧，没有时返回 frames()
+    uint32_t next_keyframe(uint32_t frame) const;
+};
+
+struct PlaybackStats {
+    uint64_t decoded = 0;  // 解码线程送出的帧
+    uint64_t late = 0;     // 到显示时已经过时、被后面的帧顶掉的帧
+    uint64_t seeks = 0;    // 解码器跳到关键帧的次数
+    size_t buffered = 0;   // 已解码、等待显示的帧
+};
+
+// 录像回放：后台线程按帧索引预先解码，放进有界的帧环，UI 线程按播放时钟取帧。
+// 定位/逐帧后退只从所属关键帧开始解码，不从文件开头；
+// 快进（超过 2x）只解码关键帧，按倍速挑选，解码量不随倍速增长
+class PlaybackEngine {
+    struct Decoded {
+        cv::Mat image;
+        uint32_t frame;
+        int64_t pts_ms;
+    };
+
+    std::string path;
+    KeyframeIndex index;  // 解码线程建好后只读
+    size_t depth;
+    std::thread worker;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;  // 定位请求、帧环有空位或要求停止
+    std::deque<Decoded> ring;
+    bool stopping = false;
+    std::atomic<bool> cancel_index{false};  // close() 置位：大文件的索引建到一半也马上放弃，界面线程不用等
+    bool ready = false;            // 帧索引已就绪
+    bool failed = false;
+    bool finished = false;         // 解码到了结尾
+    bool seek_pending = false;
+    uint32_t seek_frame = 0;
+    int64_t start_ms = 0;          // 索引就绪前收到的定位请求
+    bool show_next = false;        // 定位/逐帧后下一帧立即显示，不等时钟
+    bool playing = false;
+    double speed = 1.0;
+    int64_t anchor_wall_ns = 0;    // 播放时钟：anchor_wall_ns 时刻对应 anchor_pts_ms
+    int64_t anchor_pts_ms = 0;
+    uint32_t shown_frame = 0;
+    int64_t shown_pts_ms = 0;
+    bool shown = false;
+    PlaybackStats counters;
+
+    void run();
+    void request_seek(uint32_t frame, bool show);  // 需持有 mutex
+    void reanchor();                               // 需持有 mutex
+public:
+    explicit PlaybackEngine(size_t depth = 8);
+    PlaybackEngine(const PlaybackEngine&) = delete;
+    PlaybackEngine& operator=(const PlaybackEngine&) = delete;
+    ~PlaybackEngine();
+
+    // 打开录像并启动解码线程，立即返回；帧索引在解码线程上加载或建立。文件不可读时返回 false
+    bool open(const std::string& path);
+    void close();
+    bool is_open() const { return worker.joinable(); }
+    bool is_ready() const;
+    bool has_failed() const;
+
+    void play();
+    void pause();
+    bool is_playing() const;
+    // 正在播放、索引还在建立或有定位后待显示的帧：UI 需要持续刷新
+    bool needs_refresh() const;
+    // 0.25x-16x；超过 2x 时只显示关键帧
+    void set_speed(double speed);
+    double get_speed() const;
+    // 拖动进度：定位到显示时间不晚于 ms 的那一帧；索引未就绪时在就绪后生效
+    void seek(int64_t ms);
+    // 暂停并前进/后退 frames 帧；前进一帧通常直接取自帧环
+    void step(int frames);
+
+    // UI 线程：有该显示的新帧时写入 out 并返回 true
+    bool poll(cv::Mat& out);
+    int64_t position_ms() const;
+    int64_t duration_ms() const;
+    const std::string& filename() const { return path; }
+    PlaybackStats stats() const;
+};
+
+#endif // PLAYBACK_ENGINE_H
@@ -0,0 +1,62 @@
+#ifndef PREROLL_BUFFER_H
+#define PREROLL_BUFFER_H
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "frame_bus.h"
+
+// 压缩存放的一帧
+struct EncodedFrame {
+    std::vector<uchar> jpeg;
+    FrameMeta meta;
+    uint64_t generation = 0;
+};
+
+struct PrerollStats {
+    size_t frames = 0;
+    size_t bytes = 0;
+    double seconds = 0.0;       // 缓冲区覆盖的采集时间
+    uint64_t skipped = 0;       // 压缩跟不上、被订阅队列丢掉的帧
+};
+
+// 录制前回溯：持续保留最近 N 秒的帧（JPEG 压缩，限制内存），开始录制时先写入这些帧。
+// 作为总线的一个订阅者运行在自己的线程上，压缩不占用采集线程
+class PrerollBuffer {
+    FrameBus& bus;
+    std::shared_ptr<FrameSubscription> subscription;
+    double seconds;
+    int quality;
+    size_t max_bytes;
+
+    std::thread worker;
+    std::atomic<bool> stopping{false};
+    mutable std::mutex frames_mutex;
+    std::deque<EncodedFrame> frames;
+    size_t bytes = 0;
+    uint64_t handled = 0;                // 压缩线程处理过的最新发布序号（含压缩失败的帧），受 frames_mutex 保护
+    std::condition_variable handled_cv;
+
+    void run();
+    void trim();
+public:
+    PrerollBuffer(FrameBus& bus, double seconds, int quality = 80, size_t max_bytes = 64 * 1024 * 1024);
+    PrerollBuffer(const PrerollBuffer&) = delete;
+    PrerollBuffer& operator=(const PrerollBuffer&) = delete;
+    ~PrerollBuffer();
+
+    // 等压缩线程处理完发布序号早于 generation 的帧（订阅队列里还可能排着几帧），超时返回 false
+    bool wait_until(uint64_t generation, std::chrono::milliseconds timeout);
+    // 复制出发布序号早于 generation 的帧（从旧到新），缓冲区本身不变
+    std::vector<EncodedFrame> frames_before(uint64_t generation) const;
+    PrerollStats stats() const;
+    double duration() const { return seconds; }
+};
+
+#endif // PREROLL_BUFFER_H
@@ -0,0 +1,78 @@
+#ifndef RECORDING_INDEX_H
+#define RECORDING_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 一个录制文件（或滚动录制的一个分段）
+struct RecordingEntry {
+    uint32_t camera = 0;
+    int64_t start_ms = 0;  // Unix 时间（毫秒）
+    int64_t end_ms = 0;
+    uint64_t bytes = 0;
+    std::string filename;
+};
+
+// 持久化的录制索引：定长记录只追加写入 mmap 的文件，按摄像头和时间查询。
+// 每条记录最后写校验和，追加返回前同步写回磁盘：进程崩溃或断电后重新打开，
+// 已返回的记录都在，写到一半的那条残缺记录会被忽略；
+// 有效记录总是文件开头连续的一段，打开时二分查找末尾，不需要扫描全部记录。
+// 第一次使用时才打开文件并建立按开始时间排序的内存索引（每条 24 字节），
+// 查询只需二分查找加少量比较，几万个文件也在微秒级。
+// 一个索引文件只应由一个 RecordingIndex 对象写入；多个摄像头共用时共享同一个对象。
+// 所有方法线程安全
+class RecordingIndex {
+    struct Span {
+        int64_t start_ms;
+        int64_t end_ms;
+        uint32_t record;
+    };
+    // 一个摄像头的记录，按开始时间排序
+    struct CameraSpans {
+        std::vector<Span> spans;
+        int64_t max_length_ms = 0;  // 最长的一段，查询时据此确定向前找多远
+    };
+
+    std::string path;
+    std::mutex mutex;
+    bool loaded = false;
+    int fd = -1;
+    uint8_t* map = nullptr;
+    size_t map_bytes = 0;
+    size_t capacity = 0;  // 文件中已分配的记录数
+    size_t count = 0;     // 有效记录数
+    std::map<uint32_t, CameraSpans> cameras;
+
+    bool load();
+    void unload();
+    bool map_file(size_t records);
+    bool committed(size_t record) const;
+    RecordingEntry read(size_t record) const;
+    bool append_locked(const RecordingEntry& entry);
+    // 写入一条填好的定长记录，需持有 mutex 且已 load()
+    bool write_record(const void* record);
+    void add_span(uint32_t camera, int64_t start_ms, int64_t end_ms, uint32_t record);
+public:
+    explicit RecordingIndex(const std::string& path);
+    RecordingIndex(const RecordingIndex&) = delete;
+    RecordingIndex& operator=(const RecordingIndex&) = delete;
+    ~RecordingIndex();
+
+    // 追加一条记录；文件名超过记录容量时返回 false
+    bool append(const RecordingEntry& entry);
+    // 文件已删除：追加一条删除标记，之后的查询（包括重新打开后）不再返回它；没有这条记录时返回 false
+    bool remove(uint32_t camera, const std::string& filename);
+    // 与 [from_ms, to_ms] 有重叠的记录，按开始时间排序
+    std::vector<RecordingEntry> query(uint32_t camera, int64_t from_ms, int64_t to_ms);
+    // 有效（未删除）的记录数
+    size_t size();
+    // 扫描 directory 中的录制文件（并行读取文件信息），替换 camera 的全部记录，其他摄像头不变；
+    // 新索引先写到临时文件再改名，中途失败时原索引不受影响。返回扫描到的文件数，失败返回 -1
+    long rebuild(const std::string& directory, uint32_t camera);
+};
+
+#endif // RECORDING_INDEX_H
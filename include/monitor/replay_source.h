@@ -0,0 +1,29 @@
+#ifndef REPLAY_SOURCE_H
+#define REPLAY_SOURCE_H
+
+#include "frame_source.h"
+#include <chrono>
+
+// 回放帧源：把录好的文件当作摄像头输出，可按原速或全速回放
+class ReplaySource : public FrameSource {
+    std::string filename;
+    cv::VideoCapture capture;
+    bool max_speed;     // true 时不做节拍控制，尽快输出
+    bool loop;          // 到达结尾后从头再来
+    double fps;
+    int frame_width;
+    int frame_height;
+    LeaseBufferPool pool;
+    std::chrono::steady_clock::time_point next_frame_time;
+public:
+    ReplaySource(const std::string& filename, bool max_speed = false, bool loop = false,
+                 unsigned int buffer_count = 4);
+    bool acquire_frame(FrameLease& lease, int timeout_ms = 2000) override;
+    void initFrame(cv::Mat& frame) override;
+    int width() const override { return frame_width; }
+    int height() const override { return frame_height; }
+    uint32_t pixel_format() const override { return V4L2_PIX_FMT_BGR24; }
+    bool is_open() const override { return capture.isOpened(); }
+};
+
+#endif // REPLAY_SOURCE_H
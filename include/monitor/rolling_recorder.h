@@ -0,0 +1,93 @@
+#ifndef ROLLING_RECORDER_H
+#define ROLLING_RECORDER_H
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "video_sink.h"
+
+// 滚动录制参数
+struct RollingOptions {
+    int segment_seconds = 60;         // 每个文件的时长（按采集时间戳切分）
+    std::string directory = "rolling";  // 单独的目录：保留策略只在这里删文件
+    std::string prefix = "recording";  // 文件名 <prefix>_YYYYmmdd_HHMMSS[_n]<extension>，清理时只认这种名字
+    std::string extension = ".mp4";
+    int max_age_minutes = 0;          // 超过这个时间的分段被删除，0 表示不按时间删除
+    uint64_t max_total_bytes = 0;     // 分段总大小上限，超出时从最旧的开始删除，0 表示不限
+    bool nv12 = false;                // 帧是 NV12，经 ffmpeg 管道编码（见 open_video_sink）
+};
+
+// 关闭后的分段
+struct SegmentInfo {
+    std::string filename;
+    std::chrono::system_clock::time_point start_time;
+    std::chrono::system_clock::time_point end_time;
+    uint64_t frames = 0;
+};
+
+struct RollingStats {
+    uint64_t segments_closed = 0;
+    uint64_t segments_deleted = 0;
+    uint64_t bytes_retained = 0;  // 最近一次清理后目录中保留的分段总大小
+};
+
+// 7x24 连续录制：按固定时长切成一串文件，旧文件由后台保留策略按时间和磁盘预算删除。
+// 换段时先打开新文件再把旧的交给后台线程收尾（写文件尾、登记、清理），
+// 录制线程不等待旧文件关闭，采集端也就不会因为换段而积压或丢帧
+class RollingRecorder {
+    struct Closing {
+        std::unique_ptr<VideoSink> writer;
+        SegmentInfo info;
+    };
+
+    int codec;
+    double fps;
+    RollingOptions options;
+    std::function<void(const SegmentInfo&)> on_closed;  // 在后台线程上调用
+    std::function<void(const std::string&)> on_deleted;  // 保留策略删掉一个分段后在后台线程上调用
+
+    std::unique_ptr<VideoSink> writer;  // 当前分段，只由录制线程访问
+    SegmentInfo current;
+    int64_t segment_start_ns = 0;
+
+    std::thread closer;
+    std::mutex closing_mutex;
+    std::condition_variable closing_cv;
+    std::deque<Closing> closing;
+    std::string open_path;  // 正在写的分段，清理时跳过；受 closing_mutex 保护
+    bool stopping = false;
+
+    std::atomic<uint64_t> closed_count{0};
+    std::atomic<uint64_t> deleted_count{0};
+    std::atomic<uint64_t> retained_bytes{0};
+
+    bool open_segment(const cv::Size& size);
+    void close_segment(std::unique_ptr<VideoSink> segment, const SegmentInfo& info);
+    void closer_loop();
+    void enforce_retention();
+    bool is_segment_name(const std::string& name) const;
+public:
+    RollingRecorder(int codec, double fps, const RollingOptions& options,
+                    std::function<void(const SegmentInfo&)> on_closed = nullptr,
+                    std::function<void(const std::string&)> on_deleted = nullptr);
+    RollingRecorder(const RollingRecorder&) = delete;
+    RollingRecorder& operator=(const RollingRecorder&) = delete;
+    ~RollingRecorder();
+
+    // 录制线程：写入一帧，采集时间超过当前分段时长时换到新文件
+    bool write(const cv::Mat& frame, int64_t capture_ns);
+    // 录制线程：关闭当前分段，等后台收尾完成
+    void finish();
+
+    RollingStats stats() const;
+};
+
+#endif // ROLLING_RECORDER_H
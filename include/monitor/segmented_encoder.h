@@ -0,0 +1,118 @@
+#ifndef SEGMENTED_ENCODER_H
+#define SEGMENTED_ENCODER_H
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 分段并行编码的参数
+struct SegmentedEncoderOptions {
+    int workers = 0;            // 编码线程数，0 表示 CPU 核数减一（至少 1）
+    int segment_frames = 30;    // 每段最多帧数；每段由独立的编码器从关键帧开始编码，天然按 GOP 对齐
+    int min_segment_frames = 8; // 内存上限缩短段长时不短于它：段太短时关键帧和每段的编码器开销占比过高
+    int max_pending = 0;        // 最多在途（排队+编码中）的段数，0 表示 workers * 2；满时 write() 等待
+    // 帧内存上限：排队/编码中的段、正在填充的段和待复用的缓冲区合计不超过它，
+    // 0 表示按线程数取 (workers + 1) * 128 MB。
+    // 段长按上限推出：workers + 1 段（每个线程一段，加上正在填充的一段）同时装得下，线程池不空等；
+    // 推出的段长短于 min_segment_frames 时保持 min_segment_frames，改为少几个线程同时编码。
+    // 例如 8 线程、默认上限：1080p BGR（每帧约 6 MB）每段 20 帧，8 个线程都在编码；
+    // 4K（每帧约 25 MB）每段 8 帧，约 5 个线程在编码。内存换并行度，需要时调大上限
+    size_t max_pending_bytes = 0;
+    bool keep_segments = false; // 拼接成功后保留分段文件
+    // 帧是 NV12（见 FrameLease::to_nv12），分段经 ffmpeg 管道编码（见 open_video_sink）；
+    // 每帧只有 BGR 的一半大，同样的内存上限下段长翻倍
+    bool nv12 = false;
+};
+
+// 分段编码统计
+struct SegmentedEncoderStats {
+    uint64_t frames = 0;
+    uint64_t segments_encoded = 0;
+    uint64_t segments_failed = 0;
+    uint64_t producer_waits = 0;  // write() 因在途段过多或内存上限而等待的次数
+    size_t pending = 0;
+    size_t bytes_in_flight = 0;   // 当前占用的帧内存（含待复用的缓冲区）
+    size_t peak_bytes = 0;        // 帧内存占用的历史最大值
+    int segment_frames = 0;       // 按帧大小和内存上限实际采用的段长，写入第一帧后才有
+};
+
+// 把录制流切成短段，在线程池上并行编码，结束时按顺序拼接成最终文件。
+// 单个编码器只能用一个核编码；按段切开后编码吞吐随核数增长。
+// 帧拷贝到编码完回收的缓冲区里，不长期引用采集端的像素内存（否则采集端每帧都要重新分配），
+// 帧内存总量受 max_pending_bytes 限制，段长随帧大小缩短，让所有线程都有段可编。
+// 分段文件名为 <输出名>.partNNNN<扩展名>；拼接用 ffmpeg 的 concat 分离器做流拷贝（不重新编码），
+// 系统里没有 ffmpeg 时保留分段文件和 .ffconcat 播放列表
+class SegmentedEncoder {
+    struct Segment {
+        size_t index = 0;
+        std::vector<cv::Mat> frames;
+        size_t bytes = 0;
+        std::string path;
+        bool ok = false;
+    };
+
+    std::string output;
+    int codec;
+    double fps;
+    SegmentedEncoderOptions options;
+
+    std::shared_ptr<Segment> current;          // 录制线程正在填充的段
+    std::vector<std::shared_ptr<Segment>> segments;  // 已提交的段，按序号排列
+    std::deque<std::shared_ptr<Segment>> jobs;
+    std::vector<std::thread> workers;
+    std::mutex jobs_mutex;
+    std::condition_variable jobs_cv;     // 有新段或要求停止
+    std::condition_variable done_cv;     // 有段编码完成
+    size_t pending = 0;                  // 排队+编码中的段数，受 jobs_mutex 保护
+    // 帧内存，受 jobs_mutex 保护：在途段、正在填充的段、编码完待复用的缓冲区
+    size_t pending_bytes = 0;
+    size_t held_bytes = 0;
+    std::vector<cv::Mat> spare;
+    size_t spare_bytes = 0;
+    size_t peak_bytes = 0;
+    int segment_length = 0;              // 当前帧大小下的段长，只由录制线程访问
+    size_t segment_frame_bytes = 0;      // segment_length 对应的每帧字节数
+    bool stopping = false;
+    bool finished = false;
+
+    std::atomic<uint64_t> frame_count{0};
+    std::atomic<uint64_t> encoded_count{0};
+    std::atomic<uint64_t> failed_count{0};
+    std::atomic<uint64_t> wait_count{0};
+
+    std::string segment_path(size_t index) const;
+    // 每帧 frame_bytes 字节时的段长：workers + 1 段装得下内存上限，限制在 [min_segment_frames, segment_frames]
+    int segment_length_for(size_t frame_bytes) const;
+    void submit_current();
+    void submit_locked(std::unique_lock<std::mutex>& lock);
+    // 需持有 jobs_mutex：再占用 bytes 字节后仍不超过内存上限
+    bool fits_locked(size_t bytes) const;
+    // 需持有 jobs_mutex：为一帧取得缓冲区（优先复用），必要时等编码腾出内存
+    cv::Mat acquire_buffer(std::unique_lock<std::mutex>& lock, const cv::Mat& frame, size_t bytes);
+    void worker_loop();
+    static bool encode_segment(Segment& segment, int codec, double fps, bool nv12);
+    bool concatenate();
+public:
+    SegmentedEncoder(const std::string& output, int codec, double fps,
+                     const SegmentedEncoderOptions& options = SegmentedEncoderOptions());
+    SegmentedEncoder(const SegmentedEncoder&) = delete;
+    SegmentedEncoder& operator=(const SegmentedEncoder&) = delete;
+    ~SegmentedEncoder();
+
+    // 录制线程：追加一帧（拷贝到复用的缓冲区），凑满一段就交给线程池；内存到上限时等待
+    void write(const cv::Mat& frame);
+    // 录制线程：提交最后一段，等全部编码完成后按顺序拼接；所有段都成功且拼接成功时返回 true。
+    // 返回 false 时输出文件不存在（拼接失败时删掉 ffmpeg 写了一半的文件），分段文件保留
+    bool finish();
+
+    SegmentedEncoderStats stats();
+    int worker_count() const { return static_cast<int>(workers.size()); }
+};
+
+#endif // SEGMENTED_ENCODER_H
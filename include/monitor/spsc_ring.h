@@ -0,0 +1,104 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// 固定容量的单生产者/单消费者环形队列（无锁）。
+// 槽位在构造时一次性分配，出队后不销毁，生产者下次写入时直接复用槽位里的内存
+// （例如 cv::Mat 的像素缓冲区），因此稳定运行时没有逐帧的堆分配。
+// 生产者：begin_push() 取得空槽写入，再 commit_push() 发布；
+//         队列满时可以用 evict_oldest() 丢掉最旧的未读元素腾出槽位。
+// 消费者：front() 认领队首（此后生产者不会碰这个槽位），用完后 pop() 归还。
+template <typename T>
+class SpscRing {
+    static constexpr size_t kNone = ~static_cast<size_t>(0);
+
+    std::vector<T> slots;
+    size_t mask;
+    // 读写位置分处不同缓存行，避免生产者和消费者互相踩缓存行。
+    // head 由消费者认领和生产者淘汰共同推进（CAS），reading 是消费者正在读的位置
+    alignas(64) std::atomic<size_t> head{0};     // 下一个未读元素
+    alignas(64) std::atomic<size_t> reading{kNone};
+    alignas(64) std::atomic<size_t> tail{0};     // 生产者位置
+
+    static size_t round_up(size_t n) {
+        size_t p = 1;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+public:
+    // 容量向上取整为 2 的幂
+    explicit SpscRing(size_t capacity) : slots(round_up(capacity < 1 ? 1 : capacity)), mask(slots.size() - 1) {}
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // 生产者：返回可写的槽位，队列满（或槽位的上一个元素正被消费者读取）时返回 nullptr
+    T* begin_push() {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t >= slots.size()) {
+            const size_t previous = t - slots.size();  // 这个槽位上一次存放的元素
+            if (previous >= head.load(std::memory_order_seq_cst) || previous == reading.load(std::memory_order_seq_cst)) {
+                return nullptr;
+            }
+        }
+        return &slots[t & mask];
+    }
+    // 生产者：begin_push() 返回 nullptr 是因为要写的槽位正被消费者读取（队列满、消费者停在最旧的那个元素上）。
+    // 这时淘汰别的元素也腾不出这个槽位
+    bool push_blocked_by_reader() const {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        return t >= slots.size() && t - slots.size() == reading.load(std::memory_order_seq_cst);
+    }
+    // 生产者：发布 begin_push() 返回的槽位
+    void commit_push() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    // 生产者：丢弃最旧的未读元素并返回它的槽位（之后归生产者所有），
+    // 队列空或消费者抢先认领了它时返回 nullptr
+    T* evict_oldest() {
+        size_t h = head.load(std::memory_order_seq_cst);
+        if (h == tail.load(std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        if (!head.compare_exchange_strong(h, h + 1, std::memory_order_seq_cst)) {
+            return nullptr;
+        }
+        return &slots[h & mask];
+    }
+
+    // 消费者：认领并返回队首槽位，队列空时返回 nullptr；未 pop() 前重复调用返回同一个槽位
+    T* front() {
+        size_t r = reading.load(std::memory_order_relaxed);
+        if (r != kNone) {
+            return &slots[r & mask];
+        }
+        size_t h = head.load(std::memory_order_seq_cst);
+        while (h != tail.load(std::memory_order_acquire)) {
+            // 先声明要读的位置再认领，生产者据此避开这个槽位；与 evict_oldest 竞争失败时重试
+            reading.store(h, std::memory_order_seq_cst);
+            if (head.compare_exchange_strong(h, h + 1, std::memory_order_seq_cst)) {
+                return &slots[h & mask];
+            }
+        }
+        reading.store(kNone, std::memory_order_seq_cst);
+        return nullptr;
+    }
+    // 消费者：归还 front() 返回的槽位（内容保留，供生产者复用）
+    void pop() {
+        reading.store(kNone, std::memory_order_release);
+    }
+
+    // 任意线程：近似的未读元素数（不含消费者正在读的那个）
+    size_t size() const {
+        const size_t h = head.load(std::memory_order_acquire);  // 先读 head，保证结果不会为负
+        return tail.load(std::memory_order_acquire) - h;
+    }
+    bool empty() const { return size() == 0; }
+    size_t capacity() const { return slots.size(); }
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,41 @@
+#ifndef SYNTHETIC_SOURCE_H
+#define SYNTHETIC_SOURCE_H
+
+#include "frame_source.h"
+#include <chrono>
+#include <random>
+
+// 合成帧源：按给定分辨率、格式、帧率和抖动生成测试图案，
+// 用于在没有摄像头的机器上做基准测试和长时间压力测试
+class SyntheticSource : public FrameSource {
+    int frame_width;
+    int frame_height;
+    uint32_t format;        // V4L2_PIX_FMT_YUYV、V4L2_PIX_FMT_NV12、V4L2_PIX_FMT_MJPEG 或 V4L2_PIX_FMT_BGR24
+    double fps;
+    double jitter_ms;       // 每帧到达时间的随机抖动（均匀分布，±jitter_ms）
+    uint64_t frame_counter; // 已生成的帧数（同时作为帧序号）
+    uint64_t dropped;       // 缓冲区全部借出而丢掉的帧数
+    uint32_t pending_drops; // 上一次成功出帧之后丢掉的帧数
+    cv::Mat pattern;        // 预先生成的背景图案（MJPEG 时为 BGR）
+    cv::Mat canvas;         // MJPEG 编码前的 BGR 画布
+    std::vector<uchar> encoded;
+    LeaseBufferPool pool;
+    std::mt19937 rng;
+    std::chrono::steady_clock::time_point next_frame_time;
+
+    void render(cv::Mat& dst);
+public:
+    SyntheticSource(int width = 640, int height = 480, double fps = 30.0,
+                    uint32_t format = V4L2_PIX_FMT_YUYV, double jitter_ms = 0.0,
+                    unsigned int buffer_count = 4);
+    bool acquire_frame(FrameLease& lease, int timeout_ms = 2000) override;
+    void initFrame(cv::Mat& frame) override;
+    int width() const override { return frame_width; }
+    int height() const override { return frame_height; }
+    uint32_t pixel_format() const override { return format; }
+    bool is_open() const override { return true; }
+    uint64_t dropped_frames() const override { return dropped; }
+    uint64_t frames_generated() const { return frame_counter; }
+};
+
+#endif // SYNTHETIC_SOURCE_H
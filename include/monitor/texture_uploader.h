@@ -0,0 +1,70 @@
+#ifndef TEXTURE_UPLOADER_H
+#define TEXTURE_UPLOADER_H
+
+#include <opencv2/opencv.hpp>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <cstdint>
+
+// 纹理上传方式，按驱动能力从高到低选择
+enum class UploadPath {
+    Direct,         // glTexSubImage2D 直接读客户端内存（同步拷贝）
+    Pbo,            // 轮换的像素缓冲对象，每帧重新映射（孤立旧存储，不等 GPU）
+    PersistentPbo,  // 一次映射的持久缓冲区，分段轮换，用 fence 确认 GPU 已读完
+};
+
+const char* upload_path_name(UploadPath path);
+
+struct UploadStats {
+    uint64_t uploads = 0;
+    uint64_t skipped = 0;       // 帧没变、省掉的上传次数
+    uint64_t fence_stalls = 0;  // 轮到的分段 GPU 还没读完、只能等待的次数
+    double last_copy_ms = 0.0;  // 最近一帧写入暂存区所用的 CPU 时间
+};
+
+// 把 BGR/BGRA 帧上传到 GL_RGBA8 纹理。
+// CPU 只把像素写入像素缓冲对象，之后的 glTexSubImage2D 由驱动异步 DMA，与渲染重叠；
+// 三段轮换，GPU 读上一帧时 CPU 已经在写下一段。
+// 所有方法都只能在持有 GL 上下文的线程（UI 线程）调用
+class TextureUploader {
+    static constexpr int kBuffers = 3;
+
+    GLuint texture = 0;
+    int width = 0;
+    int height = 0;
+    size_t frame_bytes = 0;  // 一帧 BGRA 的字节数，也是每段的大小
+    UploadPath path = UploadPath::Direct;
+    UploadPath preferred_path = UploadPath::PersistentPbo;  // 尺寸变化重建时沿用
+    GLuint pbo[kBuffers] = {};
+    uint8_t* persistent = nullptr;  // PersistentPbo：整个缓冲区的持久映射
+    GLsync fences[kBuffers] = {};
+    int next = 0;                   // 下一帧使用的分段/缓冲区
+    uint64_t uploaded_generation = 0;  // 纹理里当前那一帧的发布序号
+    UploadStats upload_stats;
+
+    UploadPath choose_path(UploadPath preferred) const;
+    bool create_buffers();
+    void destroy_buffers();
+    // 等 GPU 用完第 index 段；等待失败时返回 false
+    bool wait_segment(int index);
+    // 把帧按 BGRA 写入 dst，BGR 帧在拷贝的同时补上 alpha
+    static void write_bgra(const cv::Mat& frame, uint8_t* dst);
+public:
+    TextureUploader() = default;
+    TextureUploader(const TextureUploader&) = delete;
+    TextureUploader& operator=(const TextureUploader&) = delete;
+
+    // 创建纹理和暂存缓冲区；驱动不支持 preferred 时自动降级
+    bool create(int width, int height, UploadPath preferred = UploadPath::PersistentPbo);
+    // 上传一帧（CV_8UC3 BGR 或 CV_8UC4 BGRA），尺寸变化时重建纹理。
+    // generation 与纹理里的帧相同时直接跳过（计入 skipped）；传 0 表示总是上传
+    bool upload(const cv::Mat& frame, uint64_t generation = 0);
+    // 释放纹理和缓冲区（需要 GL 上下文仍然有效）
+    void destroy();
+
+    GLuint texture_id() const { return texture; }
+    UploadPath get_path() const { return path; }
+    const UploadStats& stats() const { return upload_stats; }
+};
+
+#endif // TEXTURE_UPLOADER_H
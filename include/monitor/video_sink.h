@@ -0,0 +1,35 @@
+#ifndef VIDEO_SINK_H
+#define VIDEO_SINK_H
+
+#include <opencv2/opencv.hpp>
+#include <memory>
+#include <string>
+
+// 录制输出：单文件、分段编码、滚动录制都通过它写文件，不关心底下是哪个编码器
+class VideoSink {
+public:
+    virtual ~VideoSink() = default;
+    // 写入一帧：BGR，或以 nv12 打开时的 NV12 帧（(h*3/2) x w 单通道，见 FrameLease::to_nv12）；
+    // NV12 输出也接受 BGR 帧（回溯帧），写入前转换
+    virtual bool write(const cv::Mat& frame) = 0;
+    // 写完文件尾并关闭，文件完整写出时返回 true
+    virtual bool release() = 0;
+};
+
+// 打开录制输出，size 为画面尺寸，打不开时返回空指针。
+// nv12 为 false 时用 cv::VideoWriter（只接受 BGR）；
+// 为 true 时经管道把原始 NV12 交给 ffmpeg 编码，编码器按 codec 选（avc1/H264 用 libx264，mp4v 用 mpeg4，MJPG 用 mjpeg），
+// YUV 帧源的录制不必先转成 BGR 再让编码器转回 YUV
+std::unique_ptr<VideoSink> open_video_sink(const std::string& path, int codec, double fps,
+                                           const cv::Size& size, bool nv12);
+
+// PATH 里有可执行的 ffmpeg（只查一次）
+bool ffmpeg_available();
+
+// 帧的画面尺寸：nv12 输出收到的单通道帧是 NV12，行数是画面高度的 1.5 倍
+cv::Size video_frame_size(const cv::Mat& frame, bool nv12);
+
+// BGR 转成 NV12 写入 nv12，宽高须为偶数
+void bgr_to_nv12(const cv::Mat& bgr, cv::Mat& nv12);
+
+#endif // VIDEO_SINK_H
@@ -0,0 +1,59 @@
+#ifndef YUV_CONVERT_H
+#define YUV_CONVERT_H
+
+#include <cstddef>
+#include <cstdint>
+
+// YUYV 转换的目标像素排列
+enum class PixelLayout {
+    BGR,   // 3 字节，OpenCV 默认
+    BGRA,  // 4 字节，适合 GL_BGRA 纹理上传
+    RGBA,  // 4 字节
+    NV12,  // Y 平面后接交错 UV 平面，(h*3/2) x w 单通道；只重排不做颜色转换，下面的转换内核不接受它
+};
+// 排列的个数，按排列分配的数组以此为长度；新增排列时放在 NV12 之后并改这里
+constexpr size_t kPixelLayoutCount = static_cast<size_t>(PixelLayout::NV12) + 1;
+
+// 转换内核的指令集级别
+enum class SimdLevel {
+    Scalar,
+    SSE41,
+    AVX2,
+    AVX512,
+};
+
+// 把 YUYV (BT.601 limited range) 转换写入调用方提供的 dst，
+// dst 可以是纹理暂存缓冲区、编码器输入或 cv::Mat 的内存，不做任何额外分配。
+// 所有内核的结果逐字节一致；width 必须为偶数
+void yuyv_convert(const uint8_t* src, size_t src_stride,
+                  uint8_t* dst, size_t dst_stride,
+                  int width, int height, PixelLayout layout);
+
+// 半平面格式（Y 平面 + 交错 UV 平面）转换，逐行拼成 YUYV 后复用上面的内核，结果与 YUYV 路径一致。
+// chroma_shift 为 UV 的垂直下采样：NV12 为 1，NV16 为 0
+void nv_convert(const uint8_t* y_plane, size_t y_stride,
+                const uint8_t* uv_plane, size_t uv_stride,
+                uint8_t* dst, size_t dst_stride,
+                int width, int height, int chroma_shift, PixelLayout layout);
+
+// 重排成 NV12 写入 dst：height 行 Y，紧接 height/2 行交错 UV（行距都是 dst_stride），不做颜色转换。
+// 编码器大多直接吃 NV12，录制不必绕道 BGR；width、height 必须为偶数
+// 半平面源：NV12 逐行拷贝，NV16（4:2:2）的 UV 隔行取
+void nv12_from_semi_planar(const uint8_t* y_plane, size_t y_stride,
+                           const uint8_t* uv_plane, size_t uv_stride,
+                           uint8_t* dst, size_t dst_stride,
+                           int width, int height, int chroma_shift);
+// YUYV：Y 取偶数字节，UV 取偶数行的奇数字节（U0 V0 U1 V1 ... 正是 NV12 的 UV 顺序）
+void nv12_from_yuyv(const uint8_t* src, size_t src_stride,
+                    uint8_t* dst, size_t dst_stride,
+                    int width, int height);
+
+// 启动时按 CPUID 选出的内核级别
+SimdLevel yuyv_simd_level();
+const char* yuyv_simd_name(SimdLevel level);
+// 强制指定内核级别（测试和基准用），CPU 不支持时返回 false 且不改变
+bool yuyv_set_simd_level(SimdLevel level);
+// CPU 是否支持该级别
+bool yuyv_simd_supported(SimdLevel level);
+
+#endif // YUV_CONVERT_H
@@ -22,6 +22,12 @@
 #include <GLFW/glfw3.h> // Will drag system OpenGL headers
 
 Monitor* global_monitor = nullptr;
+// 采集线程发布新帧时置位并唤醒主循环，用来区分"新帧"和"用户输入"两种唤醒
+static std::atomic<bool> frame_ready{false};
+static void on_frame_ready() {
+    frame_ready = true;
+    glfwPostEmptyEvent();  // 可以在任意线程调用
+}
 void signal_handler(int signum) {
     if (global_monitor) {
         global_monitor->destroy(); // 释放资源（如摄像头、OpenGL纹理等）
@@ -49,7 +55,7 @@ static void glfw_error_callback(int error, const char* description)
 }
 
 // Main code
-int main(int, char**)
+int main(int argc, char** argv)
 {
     glfwSetErrorCallback(glfw_error_callback);
     if (!glfwInit())
@@ -147,12 +153,14 @@ int main(int, char**)
     bool show_another_window = false;
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
-    // 设置帧率上限
-    double target_fps = 60.0;
-    double frame_time = 1.0 / target_fps;
+    // 按需渲染：没有输入、没有新帧时一直睡眠，只按最低刷新率重画，节奏见 Monitor::set_refresh_options
+    int settle_frames = 0;         // 输入之后再连续画几帧，让 ImGui 的悬停/展开等状态稳定下来
+    double last_render = 0.0;
 
     std::signal(SIGINT, signal_handler); // 注册信号处理函数
-    global_monitor = new Monitor("/dev/video0");
+    // 可选参数指定帧源，例如 "synthetic:1280x720@30" 或 "replay:recording.mp4"
+    global_monitor = new Monitor(argc > 1 ? argv[1] : "/dev/video0");
+    global_monitor->set_frame_notifier(on_frame_ready);
 
     // Main loop
 #ifdef __EMSCRIPTEN__
@@ -164,7 +172,27 @@ int main(int, char**)
     while (!glfwWindowShouldClose(window))
 #endif
     {
-        glfwWaitEventsTimeout(frame_time);
+        // 睡到有输入、有新帧或到了最低刷新时间
+        const RefreshOptions& refresh = global_monitor->get_refresh_options();
+        const double frame_time = 1.0 / refresh.target_fps;
+        const double idle_time = 1.0 / refresh.min_refresh_hz;
+        const bool continuous = settle_frames > 0 || global_monitor->playback_needs_refresh();
+        const double timeout = continuous ? frame_time : idle_time;
+        const double wait_start = glfwGetTime();
+        glfwWaitEventsTimeout(timeout);
+        const bool woken_early = glfwGetTime() - wait_start < timeout;
+        const bool new_frame = frame_ready.exchange(false);
+        if (woken_early && !new_frame) {
+            settle_frames = 3;  // 输入事件
+        } else if (settle_frames > 0) {
+            --settle_frames;
+        }
+        // 帧率上限：事件来得太密时等到下一个渲染时刻
+        const double since_render = glfwGetTime() - last_render;
+        if (since_render < frame_time) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(frame_time - since_render));
+        }
+        last_render = glfwGetTime();
         // Poll and handle events (inputs, window resize, etc.)
         // You can read the io.WantCaptureMouse, io.WantCaptureKeyboard flags to tell if dear imgui wants to use your inputs.
         // - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application, or clear/overwrite your copy of the mouse data.
@@ -173,6 +201,7 @@ int main(int, char**)
         glfwPollEvents();
         if (glfwGetWindowAttrib(window, GLFW_ICONIFIED) != 0)
         {
+            global_monitor->stop_preview();  // 看不见就不采集，恢复后 display_dynamic 会重新启动
             ImGui_ImplGlfw_Sleep(10);
             continue;
         }
@@ -249,6 +278,12 @@ int main(int, char**)
 #endif
 
     // Cleanup
+    // 先停掉采集线程再拆 GLFW：通知里的 glfwPostEmptyEvent 不能在 glfwTerminate 之后调用，
+    // 释放纹理也要在 OpenGL 上下文还在的时候
+    global_monitor->set_frame_notifier(nullptr);
+    delete global_monitor; // 程序正常退出时也会释放
+    global_monitor = nullptr;
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -256,7 +291,5 @@ int main(int, char**)
     glfwDestroyWindow(window);
     glfwTerminate();
 
-    delete global_monitor; // 程序正常退出时也会释放
-
     return 0;
 }
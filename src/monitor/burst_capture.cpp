@@ -0,0 +1,275 @@
+#include "burst_capture.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+namespace {
+
+std::string burst_directory(const std::string& parent) {
+    const auto now = std::chrono::system_clock::now();
+    const std::time_t t = std::chrono::system_clock::to_time_t(now);
+    const int ms = static_cast<int>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000);
+    std::tm tm;
+    localtime_r(&t, &tm);
+    char stamp[48];
+    std::strftime(stamp, sizeof(stamp), "burst_%Y%m%d_%H%M%S", &tm);
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), "_%03d", ms);
+    const std::string base = (std::filesystem::path(parent) / (std::string(stamp) + suffix)).string();
+    // 同一毫秒内的两次连拍不写进同一个目录
+    std::string path = base;
+    for (int i = 2; std::filesystem::exists(path); ++i) {
+        path = base + "_" + std::to_string(i);
+    }
+    return path;
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+TimedFrame take(TimedFrame& slot) {
+    // 只转移引用：槽位变空，下次发布时另分配，这一帧的像素一直留给连拍
+    TimedFrame frame;
+    frame.image = std::move(slot.image);
+    frame.meta = slot.meta;
+    frame.generation = slot.generation;
+    return frame;
+}
+
+}  // namespace
+
+BurstCapture::BurstCapture(FrameBus& bus) : bus(bus) {}
+
+BurstCapture::~BurstCapture() {
+    cancel();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    set_history(0);
+}
+
+SubscriberOptions BurstCapture::history_options(size_t frames) const {
+    SubscriberOptions options;
+    options.queue_depth = frames;
+    options.policy = BackpressurePolicy::DropOldest;  // 没人读：始终是最近的 frames 帧
+    return options;
+}
+
+void BurstCapture::set_history(size_t frames) {
+    std::lock_guard<std::mutex> lock(history_mutex);
+    if (history) {
+        bus.unsubscribe(history);
+        history.reset();
+    }
+    history_frames = frames;
+    if (frames > 0) {
+        history = bus.subscribe("burst-history", history_options(frames));
+    }
+}
+
+bool BurstCapture::is_busy() const {
+    std::lock_guard<std::mutex> lock(progress_mutex);
+    return current.state == BurstState::Capturing || current.state == BurstState::Encoding;
+}
+
+BurstProgress BurstCapture::progress() const {
+    std::lock_guard<std::mutex> lock(progress_mutex);
+    return current;
+}
+
+bool BurstCapture::prepare(size_t frames, const BurstOptions& options) {
+    if (frames == 0 || is_busy()) {
+        return false;
+    }
+    if (worker.joinable()) {
+        worker.join();
+    }
+    this->options = options;
+    cancelling = false;
+
+    BurstProgress progress;
+    progress.requested = frames;
+    progress.directory = burst_directory(options.directory);
+    std::error_code ec;
+    std::filesystem::create_directories(progress.directory, ec);
+    progress.state = ec ? BurstState::Failed : BurstState::Capturing;
+    if (ec) {
+        std::cerr << "无法创建连拍目录：" << progress.directory << std::endl;
+    }
+    std::lock_guard<std::mutex> lock(progress_mutex);
+    current = progress;
+    return !ec;
+}
+
+bool BurstCapture::start_next(size_t frames, const BurstOptions& options) {
+    if (!prepare(frames, options)) {
+        return false;
+    }
+    // 预留 frames 个槽位，丢新不丢旧：收集线程偶尔被调度晚了也不会挤掉已收到的帧
+    SubscriberOptions slots;
+    slots.queue_depth = frames;
+    slots.policy = BackpressurePolicy::DropNewest;
+    subscription = bus.subscribe("burst", slots);
+    capturing = true;
+    worker = std::thread(&BurstCapture::run, this, std::vector<TimedFrame>(), frames);
+    return true;
+}
+
+bool BurstCapture::start_last(size_t frames, const BurstOptions& options) {
+    if (get_history() == 0 || !prepare(frames, options)) {
+        return false;
+    }
+    std::vector<TimedFrame> harvested;
+    {
+        std::lock_guard<std::mutex> lock(history_mutex);
+        if (history) {
+            // 先挂上新的历史订阅再摘下旧的；旧订阅不再有人写入之后由这里独占读取
+            std::shared_ptr<FrameSubscription> old = history;
+            history = bus.subscribe("burst-history", history_options(history_frames));
+            bus.unsubscribe(old);
+            while (TimedFrame* slot = old->front()) {
+                harvested.push_back(take(*slot));
+                old->pop();
+            }
+        }
+    }
+    if (harvested.size() > frames) {
+        harvested.erase(harvested.begin(), harvested.end() - frames);
+    }
+    if (harvested.empty()) {
+        std::lock_guard<std::mutex> lock(progress_mutex);
+        current.state = BurstState::Failed;
+        std::error_code ec;
+        std::filesystem::remove(current.directory, ec);  // 不留空目录
+        return false;
+    }
+    worker = std::thread(&BurstCapture::run, this, std::move(harvested), frames);
+    return true;
+}
+
+void BurstCapture::cancel() {
+    cancelling = true;
+}
+
+BurstProgress BurstCapture::wait() {
+    if (worker.joinable()) {
+        worker.join();
+    }
+    return progress();
+}
+
+void BurstCapture::collect(std::vector<TimedFrame>& frames, size_t wanted) {
+    frames.reserve(wanted);
+    auto last_frame = std::chrono::steady_clock::now();
+    while (frames.size() < wanted && !cancelling) {
+        TimedFrame* slot = subscription->wait_front(std::chrono::milliseconds(100));
+        if (slot == nullptr) {
+            if (elapsed_ms(last_frame) > options.timeout_ms) {
+                std::cerr << "连拍超时：只收到 " << frames.size() << " 帧" << std::endl;
+                break;
+            }
+            continue;
+        }
+        frames.push_back(take(*slot));
+        subscription->pop();
+        last_frame = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(progress_mutex);
+        current.captured = frames.size();
+    }
+}
+
+void BurstCapture::run(std::vector<TimedFrame> frames, size_t wanted) {
+    const auto start = std::chrono::steady_clock::now();
+    if (subscription) {
+        collect(frames, wanted);
+        bus.unsubscribe(subscription);
+        subscription.reset();
+    }
+    capturing = false;
+
+    uint64_t missed = 0;
+    for (size_t i = 1; i < frames.size(); ++i) {
+        if (frames[i].meta.sequence > frames[i - 1].meta.sequence + 1) {
+            missed += frames[i].meta.sequence - frames[i - 1].meta.sequence - 1;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(progress_mutex);
+        current.captured = frames.size();
+        current.missed = missed;
+        current.capture_ms = elapsed_ms(start);
+        if (!frames.empty()) {
+            current.span_ms = (frames.back().meta.capture_ns - frames.front().meta.capture_ns) / 1e6;
+        }
+        current.state = frames.empty() ? BurstState::Failed : BurstState::Encoding;
+    }
+    if (frames.empty()) {
+        std::error_code ec;
+        std::filesystem::remove(progress().directory, ec);  // 不留空目录
+        return;
+    }
+
+    const auto encode_start = std::chrono::steady_clock::now();
+    encode(frames);
+    std::lock_guard<std::mutex> lock(progress_mutex);
+    current.encode_ms = elapsed_ms(encode_start);
+    current.state = BurstState::Done;
+}
+
+void BurstCapture::encode(std::vector<TimedFrame>& frames) {
+    std::filesystem::path directory;
+    {
+        std::lock_guard<std::mutex> lock(progress_mutex);
+        directory = current.directory;
+    }
+    std::vector<std::string> names(frames.size());
+    {
+        // 每帧的驱动序号和采集时间，事后据此核对间隔
+        std::ofstream timestamps(directory / "timestamps.csv");
+        timestamps << "file,sequence,capture_ns\n";
+        for (size_t i = 0; i < frames.size(); ++i) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "frame_%04zu", i + 1);
+            names[i] = name + options.extension;
+            timestamps << names[i] << "," << frames[i].meta.sequence << "," << frames[i].meta.capture_ns << "\n";
+        }
+    }
+
+    std::vector<int> params;
+    if (options.extension == ".png") {
+        params = {cv::IMWRITE_PNG_COMPRESSION, options.png_compression};
+    } else {
+        params = {cv::IMWRITE_JPEG_QUALITY, options.jpeg_quality};
+    }
+    std::atomic<size_t> next{0};
+    auto encode_frames = [&]() {
+        for (size_t i = next++; i < frames.size(); i = next++) {
+            const std::string path = (directory / names[i]).string();
+            const bool ok = !frames[i].image.empty() && cv::imwrite(path, frames[i].image, params);
+            frames[i].image.release();  // 写完一帧就把内存还回去
+            std::lock_guard<std::mutex> lock(progress_mutex);
+            ++(ok ? current.encoded : current.failed);
+        }
+    };
+
+    int workers = options.workers;
+    if (workers <= 0) {
+        workers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+    }
+    workers = std::min<int>(workers, static_cast<int>(frames.size()));
+    std::vector<std::thread> pool;
+    for (int i = 1; i < workers; ++i) {
+        pool.emplace_back(encode_frames);
+    }
+    encode_frames();
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+}
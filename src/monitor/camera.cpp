@@ -1,11 +1,17 @@
 #include "camera.h"
 #include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <algorithm>
+#include <tuple>
+#include <cstdlib>
 
 Camera::Camera() : device_path("/dev/video0"),
                    fd(-1),
-                   buffer_count(0),
-                   buffers(nullptr),
-                   current_buffer(0)
+                   current_buffer(0),
+                   epoll_fd(-1),
+                   wake_fd(-1),
+                   actual_fps(0.0)
 {
     memset(&fmt, 0, sizeof(fmt)); // 初始化 fmt 结构体
     // 初始化摄像头
@@ -14,9 +20,10 @@ Camera::Camera() : device_path("/dev/video0"),
 
 Camera::Camera(const char *device_path) : device_path(device_path),
                                           fd(-1),
-                                          buffer_count(0),
-                                          buffers(nullptr),
-                                          current_buffer(0)
+                                          current_buffer(0),
+                                          epoll_fd(-1),
+                                          wake_fd(-1),
+                                          actual_fps(0.0)
 {
     memset(&fmt, 0, sizeof(fmt)); // 初始化 fmt 结构体
     std::cout << "Init camera: " << device_path << std::endl;
@@ -25,182 +32,670 @@ Camera::Camera(const char *device_path) : device_path(device_path),
 
 Camera::Camera(const std::string &device_path) : device_path(device_path), // 使用 std::string 而不是 c_str()
                                                  fd(-1),
-                                                 buffer_count(0),
-                                                 buffers(nullptr),
-                                                 current_buffer(0)
+                                                 current_buffer(0),
+                                                 epoll_fd(-1),
+                                                 wake_fd(-1),
+                                                 actual_fps(0.0)
 {
     memset(&fmt, 0, sizeof(fmt)); // 初始化 fmt 结构体
     init_v4l2();
 }
+
+Camera::Camera(const std::string &device_path, const CapturePreference &preference)
+    : device_path(device_path),
+      fd(-1),
+      current_buffer(0),
+      epoll_fd(-1),
+      wake_fd(-1),
+      preference(preference),
+      actual_fps(0.0)
+{
+    memset(&fmt, 0, sizeof(fmt)); // 初始化 fmt 结构体
+    std::cout << "Init camera: " << device_path << std::endl;
+    init_v4l2();
+}
 Camera::~Camera() {
     if (fd >= 0) {  // 检查fd是否有效
         // 关闭设备，取消映射
-        enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        ioctl(fd, VIDIOC_STREAMOFF, &type);
-        
-        // 清理所有缓冲区
+        // 先停止归还，防止仍在外面的租约在 STREAMOFF 之后再 QBUF
         cleanup_buffers();
+        enum v4l2_buf_type type = static_cast<enum v4l2_buf_type>(buf_type);
+        ioctl(fd, VIDIOC_STREAMOFF, &type);
         
         close(fd);
         fd = -1;  // 防止重复关闭
     }
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+    if (wake_fd >= 0) {
+        close(wake_fd);
+        wake_fd = -1;
+    }
 }
 void Camera::initFrame(cv::Mat& frame) {
-    // 检查是否有可用的缓冲区
-    if (buffer_count > 0 && buffers != nullptr && buffers[0].start != nullptr) {
+    // 检查是否有可用的缓冲区（MJPEG 的缓冲区在出队前内容无效，只能用空帧）
+    if (ring && ring->buffer_count > 0 && ring->buffers[0].planes[0].start != nullptr &&
+        layout.pixelformat == V4L2_PIX_FMT_YUYV) {
         // 使用第一个缓冲区初始化帧
-        frame = cv::Mat(fmt.fmt.pix.height, fmt.fmt.pix.width, CV_8UC2, buffers[0].start);
-        cv::cvtColor(frame, frame, cv::COLOR_YUV2BGR_YUYV);
+        frame.create(layout.height, layout.width, CV_8UC3);
+        yuyv_convert(static_cast<const uint8_t*>(ring->buffers[0].planes[0].start), layout.stride[0],
+                     frame.data, frame.step, layout.width, layout.height, PixelLayout::BGR);
     } else {
         // 如果没有可用缓冲区，创建一个空帧
-        frame = cv::Mat(fmt.fmt.pix.height, fmt.fmt.pix.width, CV_8UC3, cv::Scalar(0, 0, 0));
+        frame = cv::Mat(layout.height, layout.width, CV_8UC3, cv::Scalar(0, 0, 0));
+    }
+}
+// 我们能够转换为 BGR 的像素格式
+static bool is_supported_format(uint32_t pixelformat) {
+    return pixelformat == V4L2_PIX_FMT_YUYV || pixelformat == V4L2_PIX_FMT_MJPEG || is_semi_planar(pixelformat);
+}
+
+std::vector<CaptureMode> Camera::supported_modes() {
+    std::vector<CaptureMode> modes;
+    if (fd < 0) {
+        return modes;
+    }
+
+    struct v4l2_fmtdesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.type = buf_type;
+    for (desc.index = 0; ioctl(fd, VIDIOC_ENUM_FMT, &desc) == 0; ++desc.index) {
+        if (!is_supported_format(desc.pixelformat)) {
+            continue;
+        }
+
+        struct v4l2_frmsizeenum size;
+        memset(&size, 0, sizeof(size));
+        size.pixel_format = desc.pixelformat;
+        for (size.index = 0; ioctl(fd, VIDIOC_ENUM_FRAMESIZES, &size) == 0; ++size.index) {
+            // 步进型只取最大尺寸和偏好尺寸（若在范围内）
+            std::vector<std::pair<int, int>> sizes;
+            if (size.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
+                sizes.emplace_back(size.discrete.width, size.discrete.height);
+            } else {
+                const auto& sw = size.stepwise;
+                sizes.emplace_back(sw.max_width, sw.max_height);
+                if (preference.width >= static_cast<int>(sw.min_width) && preference.width <= static_cast<int>(sw.max_width) &&
+                    preference.height >= static_cast<int>(sw.min_height) && preference.height <= static_cast<int>(sw.max_height)) {
+                    sizes.emplace_back(preference.width, preference.height);
+                }
+            }
+
+            for (const auto& wh : sizes) {
+                CaptureMode mode;
+                mode.pixelformat = desc.pixelformat;
+                mode.width = wh.first;
+                mode.height = wh.second;
+
+                struct v4l2_frmivalenum ival;
+                memset(&ival, 0, sizeof(ival));
+                ival.pixel_format = desc.pixelformat;
+                ival.width = wh.first;
+                ival.height = wh.second;
+                for (ival.index = 0; ioctl(fd, VIDIOC_ENUM_FRAMEINTERVALS, &ival) == 0; ++ival.index) {
+                    // 帧间隔最小者对应最高帧率
+                    const struct v4l2_fract& f = ival.type == V4L2_FRMIVAL_TYPE_DISCRETE ? ival.discrete : ival.stepwise.min;
+                    if (f.numerator > 0) {
+                        mode.max_fps = std::max(mode.max_fps, static_cast<double>(f.denominator) / f.numerator);
+                    }
+                    if (ival.type != V4L2_FRMIVAL_TYPE_DISCRETE) {
+                        break;
+                    }
+                }
+                modes.push_back(mode);
+            }
+            if (size.type != V4L2_FRMSIZE_TYPE_DISCRETE) {
+                break;
+            }
+        }
     }
+    return modes;
 }
+
+bool Camera::negotiate_format() {
+    std::vector<CaptureMode> modes = supported_modes();
+
+    // 默认（驱动不支持枚举时）：按偏好直接设置
+    CaptureMode chosen;
+    chosen.pixelformat = preference.pixelformat ? preference.pixelformat : V4L2_PIX_FMT_YUYV;
+    chosen.width = preference.width;
+    chosen.height = preference.height;
+    chosen.max_fps = preference.fps;
+
+    if (!modes.empty()) {
+        // 评分依次比较：格式是否符合指定 > 能否达到帧率 > 分辨率差距 > 自动模式下优先免解码的 YUV > 帧率
+        const long wanted_area = static_cast<long>(preference.width) * preference.height;
+        auto score = [&](const CaptureMode& m) {
+            bool format_ok = preference.pixelformat == 0 || m.pixelformat == preference.pixelformat;
+            bool fps_ok = m.max_fps + 0.5 >= preference.fps;
+            long area_diff = std::labs(static_cast<long>(m.width) * m.height - wanted_area);
+            bool cheap = m.pixelformat != V4L2_PIX_FMT_MJPEG;
+            return std::make_tuple(format_ok, fps_ok, -area_diff, cheap, m.max_fps);
+        };
+        chosen = *std::max_element(modes.begin(), modes.end(), [&](const CaptureMode& a, const CaptureMode& b) {
+            return score(a) < score(b);
+        });
+    }
+
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = buf_type;
+    if (buf_type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+        fmt.fmt.pix_mp.width = chosen.width;
+        fmt.fmt.pix_mp.height = chosen.height;
+        fmt.fmt.pix_mp.pixelformat = chosen.pixelformat;
+        fmt.fmt.pix_mp.field = V4L2_FIELD_ANY;
+    } else {
+        fmt.fmt.pix.width = chosen.width;
+        fmt.fmt.pix.height = chosen.height;
+        fmt.fmt.pix.pixelformat = chosen.pixelformat;
+        fmt.fmt.pix.field = V4L2_FIELD_ANY;
+    }
+    if (ioctl(fd, VIDIOC_S_FMT, &fmt) < 0) {
+        std::cerr << "无法设置视频格式" << std::endl;
+        return false;
+    }
+    // 驱动可能调整了尺寸或格式，以返回值为准
+    layout = FrameLayout();
+    if (buf_type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+        layout.width = fmt.fmt.pix_mp.width;
+        layout.height = fmt.fmt.pix_mp.height;
+        layout.pixelformat = fmt.fmt.pix_mp.pixelformat;
+        layout.mem_planes = std::min<unsigned int>(std::max<unsigned int>(fmt.fmt.pix_mp.num_planes, 1), VIDEO_MAX_PLANES);
+        for (unsigned int p = 0; p < layout.mem_planes; ++p) {
+            layout.stride[p] = fmt.fmt.pix_mp.plane_fmt[p].bytesperline;
+        }
+    } else {
+        layout.width = fmt.fmt.pix.width;
+        layout.height = fmt.fmt.pix.height;
+        layout.pixelformat = fmt.fmt.pix.pixelformat;
+        layout.stride[0] = fmt.fmt.pix.bytesperline;
+    }
+    if (!is_supported_format(layout.pixelformat)) {
+        std::cerr << "驱动返回了不支持的像素格式" << std::endl;
+        return false;
+    }
+    // 没给行字节数的驱动按紧密排列处理；NV12/NV16 的 UV 行与 Y 行等宽
+    if (layout.stride[0] == 0 && layout.pixelformat != V4L2_PIX_FMT_MJPEG) {
+        layout.stride[0] = static_cast<size_t>(layout.width) * (layout.pixelformat == V4L2_PIX_FMT_YUYV ? 2 : 1);
+    }
+    if (layout.mem_planes > 1 && layout.stride[1] == 0) {
+        layout.stride[1] = layout.stride[0];
+    }
+
+    // 设置帧率，同样以驱动返回值为准
+    struct v4l2_streamparm parm;
+    memset(&parm, 0, sizeof(parm));
+    parm.type = buf_type;
+    double wanted_fps = std::min(preference.fps, chosen.max_fps > 0 ? chosen.max_fps : preference.fps);
+    parm.parm.capture.timeperframe.numerator = 1000;
+    parm.parm.capture.timeperframe.denominator = static_cast<unsigned int>(wanted_fps * 1000);
+    actual_fps = wanted_fps;
+    if (wanted_fps > 0 && ioctl(fd, VIDIOC_S_PARM, &parm) == 0 && parm.parm.capture.timeperframe.numerator > 0) {
+        actual_fps = static_cast<double>(parm.parm.capture.timeperframe.denominator) /
+                     parm.parm.capture.timeperframe.numerator;
+    }
+
+    char fourcc[5] = {0};
+    memcpy(fourcc, &layout.pixelformat, 4);
+    std::cout << "采集模式: " << fourcc << " " << layout.width << "x" << layout.height
+              << "@" << actual_fps << std::endl;
+    return true;
+}
+
 void Camera::init_v4l2() {
-    // 打开设备
-    fd = open(device_path.c_str(), O_RDWR);
+    // 打开设备（非阻塞：等待统一交给 epoll）
+    fd = open(device_path.c_str(), O_RDWR | O_NONBLOCK);
     if (fd < 0) {
         std::cerr << "无法打开摄像头设备" << std::endl;
         return;
     }
+    if (!setup_event_loop()) {
+        close(fd);
+        fd = -1;
+        return;
+    }
 
-    // 设置视频格式
-    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    fmt.fmt.pix.width = 640;
-    fmt.fmt.pix.height = 480;
-    fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
-    fmt.fmt.pix.field = V4L2_FIELD_INTERLACED;
-    if (ioctl(fd, VIDIOC_S_FMT, &fmt) < 0) {
-        std::cerr << "无法设置视频格式" << std::endl;
+    // 只提供多平面 API 的设备（采集卡、SoC ISP）走 _MPLANE 缓冲区类型
+    struct v4l2_capability cap;
+    memset(&cap, 0, sizeof(cap));
+    if (ioctl(fd, VIDIOC_QUERYCAP, &cap) == 0) {
+        uint32_t caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+        if (!(caps & V4L2_CAP_VIDEO_CAPTURE) && (caps & V4L2_CAP_VIDEO_CAPTURE_MPLANE)) {
+            buf_type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        }
+    }
+
+    // 协商并设置视频格式
+    if (!negotiate_format()) {
         close(fd);
+        fd = -1;
         return;
     }
 
+    if (!start_streaming(preference.buffer_count)) {
+        close(fd);
+        fd = -1;
+        return;
+    }
+}
+
+bool Camera::start_streaming(unsigned int count) {
     // 请求缓冲区
     struct v4l2_requestbuffers req;
-    req.count = 4;
-    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    memset(&req, 0, sizeof(req));
+    req.count = std::max(count, 1u);
+    req.type = buf_type;
     req.memory = V4L2_MEMORY_MMAP;
-    if (ioctl(fd, VIDIOC_REQBUFS, &req) < 0) {
+    if (ioctl(fd, VIDIOC_REQBUFS, &req) < 0 || req.count == 0) {
         std::cerr << "无法请求缓冲区" << std::endl;
-        close(fd);
-        return;
+        return false;
     }
 
-     // 更新实际获得的缓冲区数量
-     buffer_count = req.count;
-    
     // 安全地分配缓冲区结构数组
-    buffer_count = req.count;
-    buffers = static_cast<BufferInfo*>(calloc(buffer_count, sizeof(BufferInfo)));
-    if (!buffers) {
+    auto new_ring = std::make_shared<BufferRing>();
+    new_ring->fd = fd;
+    new_ring->notify_fd = wake_fd;
+    new_ring->type = buf_type;
+    new_ring->mem_planes = layout.mem_planes;
+    new_ring->buffer_count = req.count;
+    new_ring->buffers = static_cast<BufferInfo*>(calloc(req.count, sizeof(BufferInfo)));
+    if (!new_ring->buffers) {
         std::cerr << "无法分配缓冲区内存" << std::endl;
-        close(fd);
-        return;
+        return false;
     }
 
-    // 确保内存已清零
-    memset(buffers, 0, buffer_count * sizeof(BufferInfo));
-
-
     // 映射所有缓冲区
-    for (unsigned int i = 0; i < buffer_count; ++i) {
+    for (unsigned int i = 0; i < new_ring->buffer_count; ++i) {
         struct v4l2_buffer buf;
+        struct v4l2_plane planes[VIDEO_MAX_PLANES];
         memset(&buf, 0, sizeof(buf));
-        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        memset(planes, 0, sizeof(planes));
+        buf.type = buf_type;
         buf.memory = V4L2_MEMORY_MMAP;
         buf.index = i;
+        if (new_ring->multiplanar()) {
+            buf.m.planes = planes;
+            buf.length = new_ring->mem_planes;
+        }
         
         // 查询缓冲区
         if (ioctl(fd, VIDIOC_QUERYBUF, &buf) < 0) {
             std::cerr << "无法查询缓冲区 " << i << std::endl;
-            cleanup_buffers();
-            close(fd);
-            return;
+            return false;
         }
         
-        // 映射缓冲区
-        buffers[i].length = buf.length;
-        buffers[i].start = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buf.m.offset);
-        if (buffers[i].start == MAP_FAILED) {
-            std::cerr << "无法映射缓冲区 " << i << std::endl;
-            cleanup_buffers();
-            close(fd);
-            return;
+        // 映射缓冲区（多平面时每个内存平面单独映射）
+        for (unsigned int p = 0; p < new_ring->mem_planes; ++p) {
+            size_t length = new_ring->multiplanar() ? planes[p].length : buf.length;
+            off_t offset = new_ring->multiplanar() ? planes[p].m.mem_offset : buf.m.offset;
+            PlaneInfo& plane = new_ring->buffers[i].planes[p];
+            plane.length = length;
+            plane.start = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+            if (plane.start == MAP_FAILED) {
+                std::cerr << "无法映射缓冲区 " << i << " 平面 " << p << std::endl;
+                return false;
+            }
         }
         
-        // 入队缓冲区以开始捕获
+        // 入队缓冲区以开始捕获（QUERYBUF 填好的 planes 数组可以直接复用）
         if (ioctl(fd, VIDIOC_QBUF, &buf) < 0) {
             std::cerr << "无法入队缓冲区 " << i << std::endl;
-            cleanup_buffers();
-            close(fd);
-            return;
+            return false;
         }
     }
 
     // 开启视频流
-    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    enum v4l2_buf_type type = static_cast<enum v4l2_buf_type>(buf_type);
     if (ioctl(fd, VIDIOC_STREAMON, &type) < 0) {
         std::cerr << "无法开启视频流" << std::endl;
-        cleanup_buffers();  // 使用我们的清理函数而不是直接 munmap
-        close(fd);
-        return;
+        return false;  // new_ring 离开作用域时自动解除映射
     }
+    new_ring->streaming = true;
+    ring = new_ring;
+    have_sequence = false;  // 重新开流后驱动序号从头开始
+    window_frames = 0;
+    window_drops = 0;
+    return true;
 }
-void Camera::capture_frame(cv::Mat& frame) {
-    std::lock_guard<std::mutex> lock(cam_mutex); // 加锁，作用域内自动解锁
-    if (fd < 0 || buffers == nullptr || buffer_count == 0) {
-        std::cerr << "摄像头未正确初始化，无法捕获帧" << std::endl;
-        return;
+
+void Camera::stop_streaming() {
+    cleanup_buffers();
+    enum v4l2_buf_type type = static_cast<enum v4l2_buf_type>(buf_type);
+    ioctl(fd, VIDIOC_STREAMOFF, &type);
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = 0;
+    req.type = buf_type;
+    req.memory = V4L2_MEMORY_MMAP;
+    ioctl(fd, VIDIOC_REQBUFS, &req);
+}
+
+bool Camera::setup_event_loop() {
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (wake_fd < 0 || epoll_fd < 0) {
+        std::cerr << "无法创建 epoll/eventfd" << std::endl;
+        return false;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        std::cerr << "无法把设备加入 epoll" << std::endl;
+        return false;
     }
+    ev.data.fd = wake_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) < 0) {
+        std::cerr << "无法把 eventfd 加入 epoll" << std::endl;
+        return false;
+    }
+    return true;
+}
 
-    // 使用 poll 等待数据准备好
-    struct pollfd pfd;
-    pfd.fd = fd;
-    pfd.events = POLLIN;
-    int ret = poll(&pfd, 1, 2000); // 2秒超时
-    if (ret < 0) {
-        std::cerr << "poll 等待数据失败" << std::endl;
-        return;
-    } else if (ret == 0) {
-        std::cerr << "poll 等待超时，未收到摄像头数据" << std::endl;
+void Camera::wake() {
+    wakeup_pending = true;
+    if (wake_fd >= 0) {
+        uint64_t one = 1;
+        ssize_t ret = write(wake_fd, &one, sizeof(one));
+        (void)ret;
+    }
+}
+
+void Camera::wait_for_wake(std::chrono::steady_clock::time_point deadline) {
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    if (remaining.count() <= 0 || wake_fd < 0) {
         return;
     }
+    struct pollfd pfd;
+    pfd.fd = wake_fd;
+    pfd.events = POLLIN;
+    poll(&pfd, 1, static_cast<int>(remaining.count()));
+}
+
+bool Camera::dequeue(FrameLease& lease) {
+    std::lock_guard<std::mutex> lock(cam_mutex); // 只锁 DQBUF 和租约创建，不跨越等待
 
     // 准备出队缓冲区
     struct v4l2_buffer buf;
+    struct v4l2_plane planes[VIDEO_MAX_PLANES];
     memset(&buf, 0, sizeof(buf));
-    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    memset(planes, 0, sizeof(planes));
+    buf.type = buf_type;
     buf.memory = V4L2_MEMORY_MMAP;
+    if (ring->multiplanar()) {
+        buf.m.planes = planes;
+        buf.length = ring->mem_planes;
+    }
     
-    // 出队缓冲区
+    // 出队缓冲区；另一个线程先取走了就绪帧时返回 EAGAIN
     if (ioctl(fd, VIDIOC_DQBUF, &buf) < 0) {
-        std::cerr << "无法出队缓冲区, errno=" << errno << " (" << strerror(errno) << ")" << std::endl;
-        return;
+        if (errno != EAGAIN) {
+            std::cerr << "无法出队缓冲区, errno=" << errno << " (" << strerror(errno) << ")" << std::endl;
+        }
+        return false;
     }
     
-    
     // 记录当前缓冲区索引
     current_buffer = buf.index;
     
     // 检查缓冲区指针有效性
-    if (buffers[current_buffer].start == nullptr) {
+    if (current_buffer >= ring->buffer_count || ring->buffers[current_buffer].planes[0].start == nullptr) {
         std::cerr << "缓冲区指针无效" << std::endl;
-        return;
+        errno = EINVAL;
+        return false;
+    }
+
+    FrameMeta meta;
+    meta.dequeue_ns = monotonic_ns();
+    {
+        std::lock_guard<std::mutex> ring_lock(ring->ring_mutex);
+        ++ring->leased;
+        ring->peak_leased = std::max(ring->peak_leased, ring->leased);
+        ring->buffers[current_buffer].dequeued_ns = meta.dequeue_ns;
     }
 
-    if (fd < 0 || buffers == nullptr || buffer_count == 0) {
+    meta.sequence = buf.sequence;
+    meta.flags = buf.flags;
+    // 只有单调时钟的时间戳能和我们自己的时间比较，否则退回出队时间
+    if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC) {
+        meta.capture_ns = static_cast<int64_t>(buf.timestamp.tv_sec) * 1000000000LL +
+                          static_cast<int64_t>(buf.timestamp.tv_usec) * 1000;
+    } else {
+        meta.capture_ns = meta.dequeue_ns;
+    }
+    if (have_sequence) {
+        // 无符号减法，序号回绕时结果依然正确
+        uint32_t gap = buf.sequence - last_sequence - 1;
+        if (gap > 0 && gap < 0x80000000u) {
+            meta.dropped_before = gap;
+            driver_drops += gap;
+        }
+    }
+    have_sequence = true;
+    last_sequence = buf.sequence;
+    if (buf.flags & V4L2_BUF_FLAG_ERROR) {
+        ++error_frames;
+    }
+    ++window_frames;
+    window_drops += meta.dropped_before;
+    if (preference.auto_buffers) {
+        evaluate_ring_depth();
+    }
+
+    // 租约直接指向 mmap 内存；最后一个持有者释放时由删除器重新入队
+    LeasedFrame* leased = new LeasedFrame;
+    const BufferInfo& info = ring->buffers[current_buffer];
+    leased->width = layout.width;
+    leased->height = layout.height;
+    leased->pixelformat = layout.pixelformat;
+    leased->index = current_buffer;
+    for (unsigned int p = 0; p < ring->mem_planes; ++p) {
+        // 多平面时有效数据从 data_offset 开始，bytesused 包含这段偏移
+        size_t offset = ring->multiplanar() ? planes[p].data_offset : 0;
+        leased->planes[p].data = static_cast<uint8_t*>(info.planes[p].start) + offset;
+        leased->planes[p].bytesused = ring->multiplanar() ? planes[p].bytesused - offset : buf.bytesused;
+        leased->planes[p].stride = layout.stride[p];
+    }
+    if (is_semi_planar(layout.pixelformat)) {
+        leased->num_planes = 2;
+        if (ring->mem_planes == 1) {
+            // NV12/NV16 单缓冲区：UV 平面紧跟在 Y 平面之后
+            size_t y_size = layout.stride[0] * layout.height;
+            leased->planes[1].data = static_cast<uint8_t*>(leased->planes[0].data) + y_size;
+            leased->planes[1].bytesused = leased->planes[0].bytesused > y_size ? leased->planes[0].bytesused - y_size : 0;
+            leased->planes[1].stride = layout.stride[0];
+            leased->planes[0].bytesused -= leased->planes[1].bytesused;
+        }
+    }
+    leased->data = leased->planes[0].data;
+    leased->bytesused = leased->planes[0].bytesused;
+    leased->stride = leased->planes[0].stride;
+    leased->meta = meta;
+    std::shared_ptr<BufferRing> owner = ring;
+    lease = FrameLease(std::shared_ptr<const LeasedFrame>(leased, [owner](const LeasedFrame* f) {
+        owner->requeue(f->index);
+        delete f;
+    }));
+    return true;
+}
+
+bool Camera::acquire_frame(FrameLease& lease, int timeout_ms) {
+    if (fd < 0 || !ring || ring->buffer_count == 0 || epoll_fd < 0) {
         std::cerr << "摄像头未正确初始化，无法捕获帧" << std::endl;
+        return false;
+    }
+
+    if (pending_buffer_count != 0) {
+        apply_ring_depth();
+        if (!ring) {
+            return false;
+        }
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true) {
+        if (wakeup_pending.exchange(false)) {
+            return false;
+        }
+
+        // 所有缓冲区都在消费者手里时设备会一直报 EPOLLERR，此时只等归还通知
+        if (leased_buffers() >= ring->buffer_count) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                std::cerr << "所有缓冲区都被占用，无法捕获帧" << std::endl;
+                return false;
+            }
+            wait_for_wake(deadline);
+            uint64_t count;
+            while (read(wake_fd, &count, sizeof(count)) > 0) {
+            }
+            continue;
+        }
+
+        // 使用 epoll 等待设备可读或 eventfd 信号，等待期间不持有任何锁
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        struct epoll_event events[2];
+        int ret = epoll_wait(epoll_fd, events, 2, std::max<int>(0, static_cast<int>(remaining.count())));
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "epoll 等待数据失败" << std::endl;
+            return false;
+        } else if (ret == 0) {
+            std::cerr << "epoll 等待超时，未收到摄像头数据" << std::endl;
+            return false;
+        }
+
+        bool readable = false;
+        bool device_error = false;
+        for (int i = 0; i < ret; ++i) {
+            if (events[i].data.fd == wake_fd) {
+                // 清空计数；是 wake() 还是缓冲区归还由 wakeup_pending 区分
+                uint64_t count;
+                while (read(wake_fd, &count, sizeof(count)) > 0) {
+                }
+            } else if (events[i].events & EPOLLIN) {
+                readable = true;
+            } else if (events[i].events & EPOLLERR) {
+                device_error = true;
+            }
+        }
+
+        if (readable) {
+            if (dequeue(lease)) {
+                return true;
+            }
+            if (errno != EAGAIN) {
+                return false;
+            }
+        } else if (device_error && leased_buffers() < ring->buffer_count) {
+            // 设备出错（例如被拔出），不要忙等：等到超时或被唤醒
+            std::cerr << "摄像头设备错误" << std::endl;
+            wait_for_wake(deadline);
+            return false;
+        }
+    }
+}
+
+unsigned int Camera::leased_buffers() {
+    if (!ring) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(ring->ring_mutex);
+    return ring->leased;
+}
+
+// 每个统计窗口结束时估算需要的缓冲区数：
+// 用户态同时持有的缓冲区（峰值借出数，或最长停留时间内到达的帧数）
+// 加上驱动正在填充的一个和一个应对抖动的余量
+void Camera::evaluate_ring_depth() {
+    const double fps_now = actual_fps > 0 ? actual_fps : preference.fps;
+    const uint64_t window = std::max<uint64_t>(60, static_cast<uint64_t>(fps_now * 2));
+    if (window_frames < window) {
         return;
     }
-    
-    // 将数据转换为OpenCV的Mat格式
-    frame = cv::Mat(fmt.fmt.pix.height, fmt.fmt.pix.width, CV_8UC2, buffers[current_buffer].start);
-    cv::cvtColor(frame, frame, cv::COLOR_YUV2BGR_YUYV);
-    
-    // 处理完毕，再次入队缓冲区
+    unsigned int peak;
+    int64_t held_max;
+    {
+        std::lock_guard<std::mutex> lock(ring->ring_mutex);
+        peak = ring->peak_leased;
+        held_max = ring->held_ns_max;
+        ring->peak_leased = ring->leased;
+        ring->held_ns_max = 0;
+    }
+    const double drop_rate = static_cast<double>(window_drops) / static_cast<double>(window_frames + window_drops);
+    window_frames = 0;
+    window_drops = 0;
+
+    const int64_t interval_ns = static_cast<int64_t>(1e9 / std::max(fps_now, 1.0));
+    const unsigned int in_flight = static_cast<unsigned int>((held_max + interval_ns - 1) / interval_ns);
+    const unsigned int current = ring->buffer_count;
+    unsigned int needed = std::max(peak, in_flight) + 2;
+    unsigned int target = current;
+    if (drop_rate > preference.target_drop_rate) {
+        target = std::max(needed, current + 2);  // 仍在丢帧：按估算或至少加两个
+    } else if (needed < current) {
+        target = current - 1;                    // 余量充足：每个窗口只减一个，避免振荡
+    }
+    target = std::min(std::max(target, preference.min_buffers), preference.max_buffers);
+    if (target != current) {
+        std::cout << "缓冲区深度 " << current << " -> " << target << "（丢帧率 " << drop_rate
+                  << "，最长停留 " << held_max / 1000000 << "ms，峰值借出 " << peak << "）" << std::endl;
+        pending_buffer_count = target;
+    }
+}
+
+// REQBUFS 要求所有映射都已解除，因此只在没有任何租约持有旧环时重建
+void Camera::apply_ring_depth() {
+    std::lock_guard<std::mutex> lock(cam_mutex);
+    if (!ring || ring.use_count() > 1) {
+        return;
+    }
+    const unsigned int old_count = ring->buffer_count;
+    const unsigned int count = pending_buffer_count;
+    pending_buffer_count = 0;
+    stop_streaming();
+    if (!start_streaming(count)) {
+        std::cerr << "无法把缓冲区调整为 " << count << " 个，恢复为 " << old_count << std::endl;
+        if (!start_streaming(old_count)) {
+            std::cerr << "无法恢复缓冲区" << std::endl;
+        }
+    }
+}
+
+void BufferRing::requeue(unsigned int index) {
+    std::lock_guard<std::mutex> lock(ring_mutex);
+    if (leased > 0) {
+        --leased;
+    }
+    if (index < buffer_count) {
+        held_ns_max = std::max(held_ns_max, monotonic_ns() - buffers[index].dequeued_ns);
+    }
+    // 摄像头已关闭或正在重建缓冲区时，直接丢弃
+    if (!streaming || fd < 0) {
+        return;
+    }
+    struct v4l2_buffer buf;
+    struct v4l2_plane planes[VIDEO_MAX_PLANES];
+    memset(&buf, 0, sizeof(buf));
+    memset(planes, 0, sizeof(planes));
+    buf.type = type;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = index;
+    if (multiplanar()) {
+        buf.m.planes = planes;
+        buf.length = mem_planes;
+    }
     if (ioctl(fd, VIDIOC_QBUF, &buf) < 0) {
         std::cerr << "无法入队缓冲区" << std::endl;
-        return;
+    }
+    // 通知可能因缓冲区耗尽而等待的采集线程
+    if (notify_fd >= 0) {
+        uint64_t one = 1;
+        ssize_t ret = write(notify_fd, &one, sizeof(one));
+        (void)ret;
     }
 }
@@ -0,0 +1,144 @@
+#include "frame_bus.h"
+#include <algorithm>
+
+FrameSubscription::FrameSubscription(const std::string& name, const SubscriberOptions& options)
+    : name(name),
+      options(options),
+      queue(options.mode == DeliveryMode::Queue ? std::max<size_t>(options.queue_depth, 1) : 1,
+            options.policy, options.block_timeout_ms) {}
+
+bool FrameSubscription::due(int64_t capture_ns) {
+    if (options.max_fps <= 0) {
+        return true;
+    }
+    // 与采集线程相同的抽帧规则：允许半个间隔的抖动，落后时不补帧
+    const int64_t interval_ns = static_cast<int64_t>(1e9 / options.max_fps);
+    if (capture_ns + interval_ns / 2 < next_due_ns) {
+        ++decimated;
+        return false;
+    }
+    next_due_ns = std::max(next_due_ns + interval_ns, capture_ns);
+    return true;
+}
+
+TimedFrame* FrameSubscription::begin_delivery() {
+    return options.mode == DeliveryMode::Queue ? queue.begin_push() : &mailbox.back();
+}
+
+void FrameSubscription::finish_delivery() {
+    if (options.mode == DeliveryMode::Queue) {
+        queue.commit_push();
+    } else {
+        mailbox.publish();
+    }
+    ++delivered;
+}
+
+bool FrameSubscription::update() {
+    if (!mailbox.update()) {
+        return false;
+    }
+    has_latest = true;
+    return true;
+}
+
+SubscriberStats FrameSubscription::stats() const {
+    SubscriberStats stats;
+    stats.queue = queue.stats();
+    stats.delivered = delivered.load();
+    stats.decimated = decimated.load();
+    stats.overwritten = mailbox.overwritten();
+    return stats;
+}
+
+FrameBus::FrameBus() : subscribers(std::make_shared<SubscriberList>()) {}
+
+std::shared_ptr<FrameSubscription> FrameBus::subscribe(const std::string& name, const SubscriberOptions& options) {
+    auto subscription = std::make_shared<FrameSubscription>(name, options);
+    std::lock_guard<std::mutex> lock(subscribers_mutex);
+    // 写时复制：正在发布的快照不受影响
+    auto updated = std::make_shared<SubscriberList>(*subscribers);
+    updated->push_back(subscription);
+    subscribers = updated;
+    return subscription;
+}
+
+void FrameBus::unsubscribe(const std::shared_ptr<FrameSubscription>& subscription) {
+    std::lock_guard<std::mutex> lock(subscribers_mutex);
+    auto updated = std::make_shared<SubscriberList>(*subscribers);
+    updated->erase(std::remove(updated->begin(), updated->end(), subscription), updated->end());
+    subscribers = updated;
+}
+
+size_t FrameBus::subscriber_count() {
+    std::lock_guard<std::mutex> lock(subscribers_mutex);
+    return subscribers->size();
+}
+
+size_t FrameBus::publish(const FrameLease& lease) {
+    std::shared_ptr<const SubscriberList> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(subscribers_mutex);
+        snapshot = subscribers;
+    }
+
+    // 本帧已转换出的格式：同格式的后续订阅者直接共享第一份结果
+    struct Converted {
+        PixelLayout format;
+        cv::Mat image;
+        int64_t convert_ns;
+    };
+    Converted converted[kPixelLayoutCount];  // 每种格式最多转换一次
+    size_t converted_count = 0;
+
+    const FrameMeta& meta = lease.meta();
+    const uint64_t frame_generation = next_generation();
+    size_t delivered = 0;
+    for (const auto& subscription : *snapshot) {
+        if (!subscription->due(meta.capture_ns)) {
+            continue;
+        }
+        TimedFrame* slot = subscription->begin_delivery();
+        if (slot == nullptr) {
+            continue;  // 队列按策略丢弃了这一帧（已计数）
+        }
+        const PixelLayout format = subscription->get_options().format;
+        Converted* match = nullptr;
+        for (size_t i = 0; i < converted_count; ++i) {
+            if (converted[i].format == format) {
+                match = &converted[i];
+                break;
+            }
+        }
+        slot->meta = meta;
+        slot->generation = frame_generation;
+        if (match != nullptr) {
+            slot->image = match->image;  // 只增加引用计数
+            slot->meta.convert_ns = match->convert_ns;
+        } else {
+            // 第一个要这种格式的订阅者：直接转换进它的槽位，复用槽位的内存。
+            // 槽位的像素内存若仍被别处共享（其他订阅者还持有旧帧），就另分配一块，避免改写正在使用的图像
+            if (slot->image.u != nullptr && slot->image.u->refcount > 1) {
+                slot->image.release();
+            }
+            bool ok;
+            if (format == PixelLayout::BGR) {
+                ok = lease.to_bgr(slot->image);
+            } else if (format == PixelLayout::NV12) {
+                ok = lease.to_nv12(slot->image);
+            } else {
+                slot->image.create(lease->height, lease->width, CV_8UC4);
+                ok = lease.convert_to(slot->image.data, slot->image.step, format);
+            }
+            if (!ok) {
+                slot->image.release();
+            }
+            slot->meta.convert_ns = monotonic_ns();
+            ++conversions;
+            converted[converted_count++] = Converted{format, slot->image, slot->meta.convert_ns};
+        }
+        subscription->finish_delivery();
+        ++delivered;
+    }
+    return delivered;
+}
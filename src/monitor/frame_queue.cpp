@@ -0,0 +1,137 @@
+#include "frame_queue.h"
+
+const char* backpressure_policy_name(BackpressurePolicy policy) {
+    switch (policy) {
+    case BackpressurePolicy::DropOldest:
+        return "drop-oldest";
+    case BackpressurePolicy::DropNewest:
+        return "drop-newest";
+    case BackpressurePolicy::BlockWithDeadline:
+        return "block";
+    case BackpressurePolicy::Decimate:
+        return "decimate";
+    }
+    return "unknown";
+}
+
+FrameQueue::FrameQueue(size_t capacity, BackpressurePolicy policy, int block_timeout_ms)
+    : ring(capacity), policy(policy), block_timeout_ms(block_timeout_ms) {}
+
+void FrameQueue::set_policy(BackpressurePolicy policy, int block_timeout_ms) {
+    this->policy = policy;
+    this->block_timeout_ms = block_timeout_ms;
+}
+
+void FrameQueue::notify(std::condition_variable& cv) {
+    // 经过一次加锁，保证对方不会在检查条件和开始睡眠之间错过通知
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex);
+    }
+    cv.notify_all();
+}
+
+TimedFrame* FrameQueue::drop() {
+    ++dropped_count;
+    return nullptr;
+}
+
+TimedFrame* FrameQueue::begin_push() {
+    pending = nullptr;
+    TimedFrame* slot = nullptr;
+    switch (policy.load(std::memory_order_relaxed)) {
+    case BackpressurePolicy::DropOldest:
+        slot = ring.begin_push();
+        // 要写的槽位正被消费者读取（录制线程正在写这一帧）时，淘汰未读帧也腾不出它，
+        // 只丢新来的这一帧，已排队的帧保留
+        if (slot == nullptr && !ring.push_blocked_by_reader()) {
+            TimedFrame* evicted = ring.evict_oldest();
+            if (evicted != nullptr) {
+                bytes_buffered -= frame_bytes(*evicted);
+                ++dropped_count;
+                slot = ring.begin_push();
+            }
+        }
+        break;
+    case BackpressurePolicy::DropNewest:
+        slot = ring.begin_push();
+        break;
+    case BackpressurePolicy::BlockWithDeadline:
+        slot = ring.begin_push();
+        if (slot == nullptr) {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(block_timeout_ms.load());
+            std::unique_lock<std::mutex> lock(wait_mutex);
+            space_cv.wait_until(lock, deadline, [&]() { return (slot = ring.begin_push()) != nullptr; });
+        }
+        break;
+    case BackpressurePolicy::Decimate: {
+        // 积压越多抽得越狠，但始终均匀地留帧
+        const size_t depth = ring.size();
+        const size_t capacity = ring.capacity();
+        const uint64_t stride = depth < capacity / 2 ? 1 : (depth < capacity * 3 / 4 ? 2 : 4);
+        if (decimate_counter++ % stride != 0) {
+            return drop();
+        }
+        slot = ring.begin_push();
+        break;
+    }
+    }
+    if (slot == nullptr) {
+        return drop();
+    }
+    pending = slot;
+    return slot;
+}
+
+void FrameQueue::commit_push() {
+    if (pending == nullptr) {
+        return;
+    }
+    bytes_buffered += frame_bytes(*pending);
+    pending = nullptr;
+    ring.commit_push();
+    ++pushed_count;
+    const size_t depth = ring.size();
+    if (depth > high_water.load(std::memory_order_relaxed)) {
+        high_water.store(depth, std::memory_order_relaxed);  // 只有生产者写
+    }
+    notify(data_cv);
+}
+
+TimedFrame* FrameQueue::wait_front(std::chrono::milliseconds timeout) {
+    TimedFrame* slot = ring.front();
+    if (slot != nullptr) {
+        return slot;
+    }
+    std::unique_lock<std::mutex> lock(wait_mutex);
+    data_cv.wait_for(lock, timeout, [&]() { return (slot = ring.front()) != nullptr || woken.load(); });
+    woken = false;
+    return slot;
+}
+
+void FrameQueue::pop() {
+    TimedFrame* slot = ring.front();
+    if (slot == nullptr) {
+        return;
+    }
+    bytes_buffered -= frame_bytes(*slot);
+    ring.pop();
+    if (policy.load(std::memory_order_relaxed) == BackpressurePolicy::BlockWithDeadline) {
+        notify(space_cv);
+    }
+}
+
+void FrameQueue::wake() {
+    woken = true;
+    notify(data_cv);
+}
+
+QueueStats FrameQueue::stats() const {
+    QueueStats stats;
+    stats.pushed = pushed_count.load();
+    stats.dropped = dropped_count.load();
+    stats.depth = ring.size();
+    stats.high_water = high_water.load();
+    stats.bytes_buffered = bytes_buffered.load();
+    stats.capacity = ring.capacity();
+    return stats;
+}
@@ -0,0 +1,195 @@
+#include "frame_source.h"
+#include "camera.h"
+#include "synthetic_source.h"
+#include "replay_source.h"
+#include <sstream>
+#include <algorithm>
+
+void FrameSource::capture_frame(cv::Mat& frame) {
+    FrameLease lease;
+    if (!acquire_frame(lease)) {
+        return;
+    }
+    // 调用方的 frame 可能与别处共享数据，这里总是写入新内存；
+    // 需要复用内存的调用方应直接使用 acquire_frame + FrameLease::to_bgr
+    frame = cv::Mat();
+    lease.to_bgr(frame);
+    // lease 离开作用域时缓冲区自动归还
+}
+
+bool FrameSource::sleep_until(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    wake_cv.wait_until(lock, deadline, [this]() { return wake_requested; });
+    if (wake_requested) {
+        wake_requested = false;
+        return false;
+    }
+    return true;
+}
+
+void FrameSource::wake() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        wake_requested = true;
+    }
+    wake_cv.notify_all();
+}
+
+// 解析 "synthetic:" 之后的参数，例如 "1280x720@60,bgr,jitter=3"
+static FrameSource* create_synthetic_source(const std::string& args) {
+    int width = 640;
+    int height = 480;
+    double fps = 30.0;
+    double jitter_ms = 0.0;
+    uint32_t format = V4L2_PIX_FMT_YUYV;
+
+    std::stringstream ss(args);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        if (item == "yuyv") {
+            format = V4L2_PIX_FMT_YUYV;
+        } else if (item == "mjpeg") {
+            format = V4L2_PIX_FMT_MJPEG;
+        } else if (item == "bgr") {
+            format = V4L2_PIX_FMT_BGR24;
+        } else if (item == "nv12") {
+            format = V4L2_PIX_FMT_NV12;
+        } else if (item.compare(0, 7, "jitter=") == 0) {
+            jitter_ms = std::atof(item.c_str() + 7);
+        } else if (sscanf(item.c_str(), "%dx%d@%lf", &width, &height, &fps) >= 2) {
+            // 分辨率和帧率已解析
+        } else {
+            std::cerr << "忽略未知的合成帧源参数: " << item << std::endl;
+        }
+    }
+    return new SyntheticSource(width, height, fps, format, jitter_ms);
+}
+
+// 解析 "replay:" 之后的参数，例如 "recording_1700000000.mp4,max,loop"
+static FrameSource* create_replay_source(const std::string& args) {
+    std::stringstream ss(args);
+    std::string filename;
+    std::getline(ss, filename, ',');
+    bool max_speed = false;
+    bool loop = false;
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item == "max") {
+            max_speed = true;
+        } else if (item == "loop") {
+            loop = true;
+        } else if (!item.empty()) {
+            std::cerr << "忽略未知的回放帧源参数: " << item << std::endl;
+        }
+    }
+    return new ReplaySource(filename, max_speed, loop);
+}
+
+// 解析 "v4l2:" 之后的参数，例如 "/dev/video0,1920x1080@30,mjpeg"
+static FrameSource* create_v4l2_source(const std::string& args) {
+    std::stringstream ss(args);
+    std::string device;
+    std::getline(ss, device, ',');
+    CapturePreference preference;
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item == "yuyv") {
+            preference.pixelformat = V4L2_PIX_FMT_YUYV;
+        } else if (item == "mjpeg") {
+            preference.pixelformat = V4L2_PIX_FMT_MJPEG;
+        } else if (item == "nv12") {
+            preference.pixelformat = V4L2_PIX_FMT_NV12;
+        } else if (item == "nv16") {
+            preference.pixelformat = V4L2_PIX_FMT_NV16;
+        } else if (item == "buffers=auto") {
+            preference.auto_buffers = true;
+        } else if (item.compare(0, 8, "buffers=") == 0) {
+            preference.buffer_count = static_cast<unsigned int>(std::max(1, std::atoi(item.c_str() + 8)));
+        } else if (sscanf(item.c_str(), "%dx%d@%lf", &preference.width, &preference.height, &preference.fps) >= 2) {
+            // 分辨率和帧率已解析
+        } else if (!item.empty()) {
+            std::cerr << "忽略未知的摄像头参数: " << item << std::endl;
+        }
+    }
+    return new Camera(device, preference);
+}
+
+FrameSource* create_frame_source(const std::string& uri) {
+    if (uri.compare(0, 10, "synthetic:") == 0) {
+        return create_synthetic_source(uri.substr(10));
+    }
+    if (uri.compare(0, 7, "replay:") == 0) {
+        return create_replay_source(uri.substr(7));
+    }
+    if (uri.compare(0, 5, "v4l2:") == 0) {
+        return create_v4l2_source(uri.substr(5));
+    }
+    return new Camera(uri);
+}
+
+LeaseBufferPool::LeaseBufferPool(unsigned int count, int rows, int cols, int type)
+    : state(std::make_shared<State>()) {
+    state->slots.resize(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        if (rows > 0 && cols > 0) {
+            state->slots[i].create(rows, cols, type);
+        }
+        state->free_slots.push_back(count - 1 - i);
+    }
+}
+
+bool LeaseBufferPool::take(unsigned int& index) {
+    std::lock_guard<std::mutex> lock(state->pool_mutex);
+    if (state->free_slots.empty()) {
+        return false;
+    }
+    index = state->free_slots.back();
+    state->free_slots.pop_back();
+    return true;
+}
+
+cv::Mat& LeaseBufferPool::slot(unsigned int index) {
+    return state->slots[index];
+}
+
+FrameLease LeaseBufferPool::lease(unsigned int index, uint32_t pixelformat, size_t bytesused,
+                                  int width, int height, const FrameMeta& meta) {
+    const cv::Mat& mat = state->slots[index];
+    LeasedFrame* leased = new LeasedFrame;
+    leased->data = mat.data;
+    leased->bytesused = bytesused;
+    leased->stride = mat.step;
+    leased->width = width > 0 ? width : mat.cols;
+    leased->height = height > 0 ? height : mat.rows;
+    leased->pixelformat = pixelformat;
+    leased->index = index;
+    leased->planes[0].data = leased->data;
+    leased->planes[0].bytesused = bytesused;
+    leased->planes[0].stride = leased->stride;
+    if (is_semi_planar(pixelformat)) {
+        // 槽位中 UV 平面紧跟在 Y 平面之后
+        size_t y_size = leased->stride * leased->height;
+        leased->num_planes = 2;
+        leased->planes[0].bytesused = std::min(bytesused, y_size);
+        leased->planes[1].data = mat.data + y_size;
+        leased->planes[1].bytesused = bytesused - leased->planes[0].bytesused;
+        leased->planes[1].stride = leased->stride;
+    }
+    leased->meta = meta;
+    std::shared_ptr<State> owner = state;
+    return FrameLease(std::shared_ptr<const LeasedFrame>(leased, [owner](const LeasedFrame* f) {
+        {
+            std::lock_guard<std::mutex> lock(owner->pool_mutex);
+            owner->free_slots.push_back(f->index);
+        }
+        delete f;
+    }));
+}
+
+unsigned int LeaseBufferPool::free_count() {
+    std::lock_guard<std::mutex> lock(state->pool_mutex);
+    return static_cast<unsigned int>(state->free_slots.size());
+}
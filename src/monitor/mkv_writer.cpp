@@ -0,0 +1,295 @@
+#include "mkv_writer.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+namespace {
+
+// Matroska 元素 ID（已含长度标记位）
+const uint32_t kEbml = 0x1A45DFA3;
+const uint32_t kSegment = 0x18538067;
+const uint32_t kSeekHead = 0x114D9B74;
+const uint32_t kSeek = 0x4DBB;
+const uint32_t kSeekId = 0x53AB;
+const uint32_t kSeekPosition = 0x53AC;
+const uint32_t kVoid = 0xEC;
+const uint32_t kInfo = 0x1549A966;
+const uint32_t kTimestampScale = 0x2AD7B1;
+const uint32_t kDuration = 0x4489;
+const uint32_t kMuxingApp = 0x4D80;
+const uint32_t kWritingApp = 0x5741;
+const uint32_t kTracks = 0x1654AE6B;
+const uint32_t kTrackEntry = 0xAE;
+const uint32_t kCluster = 0x1F43B675;
+const uint32_t kTimestamp = 0xE7;
+const uint32_t kSimpleBlock = 0xA3;
+const uint32_t kCues = 0x1C53BB6B;
+
+const size_t kSeekHeadReserve = 96;  // 结束时在这里写 SeekHead，剩余部分用 Void 填满
+const int64_t kClusterMs = 1000;
+
+typedef std::vector<uint8_t> Bytes;
+
+void put_id(Bytes& out, uint32_t id) {
+    int bytes = id > 0xFFFFFF ? 4 : id > 0xFFFF ? 3 : id > 0xFF ? 2 : 1;
+    while (bytes-- > 0) {
+        out.push_back(static_cast<uint8_t>(id >> (bytes * 8)));
+    }
+}
+
+// 最短的变长尺寸编码
+void put_size(Bytes& out, uint64_t size) {
+    int length = 1;
+    while (length < 8 && size >= (UINT64_C(1) << (7 * length)) - 1) {
+        ++length;
+    }
+    const uint64_t value = size | (UINT64_C(1) << (7 * length));
+    for (int i = length - 1; i >= 0; --i) {
+        out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+    }
+}
+
+void put_be(Bytes& out, uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i) {
+        out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+    }
+}
+
+void put_uint(Bytes& out, uint32_t id, uint64_t value, int bytes = 0) {
+    if (bytes == 0) {
+        bytes = 1;
+        while (bytes < 8 && (value >> (bytes * 8)) != 0) {
+            ++bytes;
+        }
+    }
+    put_id(out, id);
+    put_size(out, bytes);
+    put_be(out, value, bytes);
+}
+
+void put_float(Bytes& out, uint32_t id, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put_id(out, id);
+    put_size(out, 8);
+    put_be(out, bits, 8);
+}
+
+void put_string(Bytes& out, uint32_t id, const std::string& value) {
+    put_id(out, id);
+    put_size(out, value.size());
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+void put_master(Bytes& out, uint32_t id, const Bytes& body) {
+    put_id(out, id);
+    put_size(out, body.size());
+    out.insert(out.end(), body.begin(), body.end());
+}
+
+int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace
+
+MkvWriter::~MkvWriter() {
+    close();
+}
+
+bool MkvWriter::open(const std::string& path, const cv::Size& size, double fps, int quality) {
+    close();
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    this->path = path;
+    width = size.width;
+    height = size.height;
+    this->fps = fps > 0 ? fps : 30.0;
+    jpeg_params = {cv::IMWRITE_JPEG_QUALITY, quality};
+    cluster.clear();
+    cluster_ms = -1;
+    cues.clear();
+    origin_ns = 0;
+    last_ms = -1;
+    frame_count = 0;
+    write_header();
+    return file.good();
+}
+
+void MkvWriter::write_header() {
+    Bytes out;
+    Bytes ebml;
+    put_uint(ebml, 0x4286, 1);  // EBMLVersion
+    put_uint(ebml, 0x42F7, 1);  // EBMLReadVersion
+    put_uint(ebml, 0x42F2, 4);  // EBMLMaxIDLength
+    put_uint(ebml, 0x42F3, 8);  // EBMLMaxSizeLength
+    put_string(ebml, 0x4282, "matroska");
+    put_uint(ebml, 0x4287, 4);  // DocTypeVersion
+    put_uint(ebml, 0x4285, 2);  // DocTypeReadVersion
+    put_master(out, kEbml, ebml);
+
+    // Segment 长度先写成“未知”，结束时回填为固定 8 字节
+    put_id(out, kSegment);
+    segment_size_pos = out.size();
+    put_be(out, UINT64_C(0x01FFFFFFFFFFFFFF), 8);
+    segment_data_pos = out.size();
+
+    seek_head_pos = out.size();
+    put_id(out, kVoid);
+    put_size(out, kSeekHeadReserve - 2);
+    out.resize(seek_head_pos + kSeekHeadReserve, 0);
+
+    info_pos = out.size() - segment_data_pos;
+    Bytes info;
+    put_uint(info, kTimestampScale, 1000000);  // 时间戳单位 1ms
+    put_string(info, kMuxingApp, "Monitor");
+    put_string(info, kWritingApp, "Monitor");
+    const size_t duration_offset = info.size();
+    put_float(info, kDuration, 0.0);
+    put_id(out, kInfo);
+    put_size(out, info.size());
+    duration_pos = out.size() + duration_offset + 3;  // 跳过 Duration 的 ID(2) 和长度(1)
+    out.insert(out.end(), info.begin(), info.end());
+
+    tracks_pos = out.size() - segment_data_pos;
+    Bytes video;
+    put_uint(video, 0xB0, width);   // PixelWidth
+    put_uint(video, 0xBA, height);  // PixelHeight
+    Bytes track;
+    put_uint(track, 0xD7, 1);       // TrackNumber
+    put_uint(track, 0x73C5, 1);     // TrackUID
+    put_uint(track, 0x83, 1);       // TrackType: video
+    put_uint(track, 0x9C, 0);       // FlagLacing
+    put_string(track, 0x86, "V_MJPEG");
+    put_master(track, 0xE0, video);
+    Bytes tracks;
+    put_master(tracks, kTrackEntry, track);
+    put_master(out, kTracks, tracks);
+
+    file.write(reinterpret_cast<const char*>(out.data()), out.size());
+}
+
+bool MkvWriter::write(const cv::Mat& frame, int64_t capture_ns) {
+    if (!file.is_open() || frame.empty()) {
+        return false;
+    }
+    if (frame.cols != width || frame.rows != height) {
+        std::cerr << "帧尺寸与录制文件不一致，跳过：" << frame.cols << "x" << frame.rows << std::endl;
+        return false;
+    }
+    if (capture_ns == 0) {
+        capture_ns = steady_now_ns();
+    }
+    if (frame_count == 0) {
+        origin_ns = capture_ns;
+    }
+    int64_t ms = (capture_ns - origin_ns) / 1000000;
+    if (ms <= last_ms) {
+        ms = last_ms + 1;
+    }
+    if (!cv::imencode(".jpg", frame, jpeg, jpeg_params)) {
+        return false;
+    }
+
+    if (cluster_ms >= 0 && ms - cluster_ms >= kClusterMs) {
+        flush_cluster();
+    }
+    if (cluster_ms < 0) {
+        cluster_ms = ms;
+        put_uint(cluster, kTimestamp, static_cast<uint64_t>(ms));
+    }
+    // SimpleBlock：轨道号、相对 Cluster 的时间戳（有符号 16 位）、关键帧标志，然后是 JPEG
+    put_id(cluster, kSimpleBlock);
+    put_size(cluster, 4 + jpeg.size());
+    cluster.push_back(0x81);
+    put_be(cluster, static_cast<uint16_t>(ms - cluster_ms), 2);
+    cluster.push_back(0x80);
+    cluster.insert(cluster.end(), jpeg.begin(), jpeg.end());
+
+    last_ms = ms;
+    ++frame_count;
+    return file.good();
+}
+
+void MkvWriter::flush_cluster() {
+    if (cluster_ms < 0) {
+        return;
+    }
+    const uint64_t pos = static_cast<uint64_t>(file.tellp()) - segment_data_pos;
+    cues.push_back({cluster_ms, pos});
+    Bytes header;
+    put_id(header, kCluster);
+    put_size(header, cluster.size());
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    file.write(reinterpret_cast<const char*>(cluster.data()), cluster.size());
+    cluster.clear();
+    cluster_ms = -1;
+}
+
+bool MkvWriter::close() {
+    if (!file.is_open()) {
+        return false;
+    }
+    flush_cluster();
+
+    const uint64_t cues_pos = static_cast<uint64_t>(file.tellp()) - segment_data_pos;
+    Bytes cue_points;
+    for (const CuePoint& cue : cues) {
+        Bytes positions;
+        put_uint(positions, 0xF7, 1);                 // CueTrack
+        put_uint(positions, 0xF1, cue.cluster_pos);   // CueClusterPosition
+        Bytes point;
+        put_uint(point, 0xB3, static_cast<uint64_t>(cue.time_ms));  // CueTime
+        put_master(point, 0xB7, positions);
+        put_master(cue_points, 0xBB, point);
+    }
+    Bytes tail;
+    put_master(tail, kCues, cue_points);
+    file.write(reinterpret_cast<const char*>(tail.data()), tail.size());
+    const uint64_t segment_end = file.tellp();
+
+    // 回填：Segment 长度、总时长、SeekHead
+    Bytes patch;
+    put_be(patch, (segment_end - segment_data_pos) | (UINT64_C(1) << 56), 8);
+    file.seekp(segment_size_pos);
+    file.write(reinterpret_cast<const char*>(patch.data()), patch.size());
+
+    patch.clear();
+    const double duration = static_cast<double>(duration_ms());
+    uint64_t bits;
+    std::memcpy(&bits, &duration, sizeof(bits));
+    put_be(patch, bits, 8);
+    file.seekp(duration_pos);
+    file.write(reinterpret_cast<const char*>(patch.data()), patch.size());
+
+    Bytes seeks;
+    const std::pair<uint32_t, uint64_t> entries[] = {{kInfo, info_pos}, {kTracks, tracks_pos}, {kCues, cues_pos}};
+    for (const auto& entry : entries) {
+        Bytes seek;
+        Bytes id;
+        put_id(id, entry.first);
+        put_id(seek, kSeekId);
+        put_size(seek, id.size());
+        seek.insert(seek.end(), id.begin(), id.end());
+        put_uint(seek, kSeekPosition, entry.second, 8);
+        put_master(seeks, kSeek, seek);
+    }
+    Bytes head;
+    put_master(head, kSeekHead, seeks);
+    put_id(head, kVoid);
+    put_size(head, kSeekHeadReserve - head.size() - 1);
+    head.resize(kSeekHeadReserve, 0);
+    file.seekp(segment_data_pos);
+    file.write(reinterpret_cast<const char*>(head.data()), head.size());
+
+    const bool ok = file.good();
+    file.close();
+    if (!ok) {
+        std::cerr << "写入录制文件失败：" << path << std::endl;
+    }
+    return ok;
+}
@@ -1,45 +1,37 @@
 #include "monitor.h"
 #include <sys/mman.h>
+#include <filesystem>
 
 
 
 
 Monitor::Monitor(const char* device_path):device_path(device_path) {
-    camera = new Camera(device_path);
+    camera = create_frame_source(this->device_path);
     init();
 }
 Monitor::Monitor(const std::string& device_path):device_path(device_path){
-    camera = new Camera(device_path);
+    camera = create_frame_source(device_path);
     init();
 }
-// 初始化 OpenGL 纹理
-void Monitor::init_texture(int width, int height) {
-    if (textureID == 0) {
-        if (width <= 0 || height <= 0) {
-            std::cerr << "无效的纹理尺寸: " << width << "x" << height << std::endl;
-            return;
-        }
-        
-        glGenTextures(1, &textureID);
-        std::cout << "Texture ID: " << textureID << std::endl;
-        
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        
-        // 初始化纹理数据
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-        
-        GLenum err = glGetError();
-        if (err != GL_NO_ERROR) {
-            std::cerr << "OpenGL 错误: " << err << std::endl;
-        }
-    }
+Monitor::Monitor(FrameSource* source):camera(source) {
+    init();
 }
 void Monitor::init() {
     // 先捕获一帧以确保frame有效
     if (camera == nullptr) {
-        camera = new Camera(device_path);
+        camera = create_frame_source(device_path);
+    }
+    if (!display_sub) {
+        SubscriberOptions options;
+        options.mode = DeliveryMode::Latest;
+        options.format = PixelLayout::BGRA;
+        display_sub = bus.subscribe("display", options);
+    }
+    if (!preroll && preroll_seconds > 0) {
+        preroll.reset(new PrerollBuffer(bus, preroll_seconds, preroll_quality));
+    }
+    if (!burst) {
+        burst.reset(new BurstCapture(bus));
     }
     
     // 等待摄像头准备就绪
@@ -48,53 +40,36 @@ void Monitor::init() {
     
     if (!tempFrame.empty()) {
         frame = tempFrame;
-        // 初始化 OpenGL 纹理
-        init_texture(frame.cols, frame.rows);
-        if (textureID != 0) {
-            // 更新纹理数据
-            glBindTexture(GL_TEXTURE_2D, textureID);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, frame.cols, frame.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, frame.data);
+        frame_generation = bus.next_generation();
+        // 初始化 OpenGL 纹理并上传第一帧
+        if (uploader.create(frame.cols, frame.rows)) {
+            uploader.upload(frame, frame_generation);
         } else {
             std::cerr << "无法创建 OpenGL 纹理" << std::endl;
         }
-        std::cout << "摄像头初始化成功，纹理 ID: " << textureID << std::endl;
+        std::cout << "摄像头初始化成功，纹理 ID: " << uploader.texture_id() << std::endl;
     } else {
         std::cerr << "无法初始化摄像头帧，纹理未创建" << std::endl;
     }
 }
-void Monitor::update_texture(const cv::Mat& frame) {
-    if (frame.empty()) {
-        std::cerr << "update_texture: frame is empty!" << std::endl;
-        return;
-    }
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame.cols, frame.rows, GL_BGR, GL_UNSIGNED_BYTE, frame.data);
-    GLenum err = glGetError();
-    if (err != GL_NO_ERROR) {
-        std::cerr << "OpenGL 错误: " << err << std::endl;
-    }
+void Monitor::update_texture(const cv::Mat& frame, uint64_t generation) {
+    // 采集线程送来的是 BGRA，直接拷进暂存区；capture_frame 得到的 BGR 在拷贝时补 alpha
+    uploader.upload(frame, generation);
+}
+void Monitor::capture_into_frame() {
+    camera->capture_frame(frame);
+    frame_generation = bus.next_generation();
 }
 void Monitor::capture(){
     if(camera == nullptr){
-        camera = new Camera(device_path);
+        camera = create_frame_source(device_path);
     }
-    // 捕获一帧图像
-    camera->capture_frame(frame);
-    
-    // 如果正在录制，将帧添加到队列
-    if (is_recording) {
-        std::unique_lock<std::mutex> lock(frame_mutex);
-        
-        // 限制队列大小，防止内存溢出（可选）
-        if (frame_queue.size() > 30) {  // 最多缓存30帧
-            frame_queue.pop();
-        }
-        
-        frame_queue.push(frame.clone());  // 使用clone以避免引用问题
-        lock.unlock();
-        
-        // 通知录制线程有新帧可用
-        frame_cv.notify_one();
+    // 捕获一帧图像；录制帧只由采集线程经总线交付（单生产者），这里不再入队。
+    // 采集线程在运行时设备归它所有，这里只取它发布的最新帧
+    if (is_frame_grabbing) {
+        take_latest_frame();
+    } else {
+        capture_into_frame();
     }
 }
 void Monitor::update(){
@@ -102,8 +77,10 @@ void Monitor::update(){
 }
 
 void Monitor::display_camera_frame(const cv::Mat& frame) {
-    // 更新纹理内容
-    update_texture(frame);
+    // 更新纹理内容：UI 以 60Hz 刷新而帧源通常只有 30fps，同一帧只上传一次
+    if (!frame.empty()) {
+        update_texture(frame, frame_generation);
+    }
 
     // 使用 ImGui 显示纹理
     start_window();
@@ -111,52 +88,98 @@ void Monitor::display_camera_frame(const cv::Mat& frame) {
     ImGui::NextColumn();
     record_button();
     capture_button();
+    playback_controls();
     end_window();
 }
 
 void Monitor::display(){
-    std::lock_guard<std::mutex> lock(frame_mutex);
-    if (!frame.empty()) {
-        display_camera_frame(frame);
-    }
+    // frame 只属于 UI 线程，纹理上传和界面构建期间不持有任何采集线程需要的锁；
+    // 还没有帧时也画出窗口，显示无信号
+    display_camera_frame(frame);
 }
 void Monitor::display_dynamic(){
-    if (is_recording) {
-        // 录制时，从队列取最新帧
-        cv::Mat latest;
-        if (get_latest_recorded_frame(latest)) {
-            frame = latest;
+    if (playback.is_open()) {
+        // 回放：帧由回放引擎按播放时钟给出，发布序号从总线取，纹理上传不会与实时帧混淆
+        stop_preview();
+        if (playback.poll(frame)) {
+            frame_generation = bus.next_generation();
+            frame_meta = FrameMeta();
         }
-        // 如果队列为空，可以选择不刷新或显示上一帧
-    } else {
-        // 非录制时，直接采集新帧
-        camera->capture_frame(frame);
+        display();
+        return;
     }
+    // UI 线程从不调用设备：设备慢或被拔掉时只有采集线程在等，界面照常刷新
+    ensure_frame_grabbing(preview_fps);
+    // 从信箱取最新帧，没有新帧就继续显示上一帧
+    take_latest_frame();
 
     display();
 }
+
+void Monitor::stop_preview() {
+    // 移动侦测（含回溯）靠采集线程送帧，开着时不停；
+    // 与录制/侦测线程的启动在同一把锁下检查，不会停掉刚为录制启动的采集
+    std::lock_guard<std::mutex> lock(grabber_mutex);
+    if (is_frame_grabbing && !is_recording && !motion_enabled && !burst->is_capturing()) {
+        stop_grabber_locked();
+    }
+}
+
+bool Monitor::is_feed_stale() const {
+    if (frame.empty() || last_frame_ns == 0) {
+        return true;
+    }
+    return monotonic_ns() - last_frame_ns > static_cast<int64_t>(stale_after_ms) * 1000000;
+}
+
+bool Monitor::take_latest_frame() {
+    if (!display_sub || !display_sub->has_fresh()) {
+        return false;
+    }
+    // 先放开对旧帧的引用，换出去的缓冲区回到采集线程时就不会被判为共享而重新分配
+    frame.release();
+    display_sub->update();
+    frame = display_sub->latest()->image;
+    frame_meta = display_sub->latest()->meta;
+    frame_generation = display_sub->latest()->generation;
+    last_frame_ns = monotonic_ns();
+    return true;
+}
 void Monitor::destroy(){
     if (camera != nullptr) {
         delete camera;
         camera = nullptr;
     }
-    if (textureID != 0) {
-        glDeleteTextures(1, &textureID);
-        textureID = 0;
-    }
+    uploader.destroy();
 }
 
 // 开始异步录制
 void Monitor::start_async_recording(const std::string& filename, int codec, double fps) {
-    // 如果已经在录制，先停止
-    if (is_recording) {
-        stop_async_recording();
+    if (recording_stopping) {
+        std::cerr << "上一次录制还在结束，稍后再开始" << std::endl;
+        return;
     }
+    // 如果已经在录制，先停止；上一次录制因文件打不开而自行结束时，在这里回收线程和订阅
+    stop_async_recording();
     
     video_filename = filename;
     video_codec = codec;
     video_fps = fps;
     
+    // 每次录制使用新的订阅，不会读到上一次残留的帧
+    SubscriberOptions options;
+    options.queue_depth = 128;  // 约 4 秒@30fps
+    options.policy = record_policy;
+    options.block_timeout_ms = record_block_timeout_ms;
+    options.max_fps = fps;  // 连拍期间采集线程不抽帧，录制仍按自己的帧率取帧
+    const uint32_t source_format = camera->pixel_format();
+    recording_nv12 = nv12_recording && recording_mode != RecordingMode::Vfr &&
+                     (is_semi_planar(source_format) || source_format == V4L2_PIX_FMT_YUYV) &&
+                     camera->width() % 2 == 0 && camera->height() % 2 == 0 && ffmpeg_available();
+    options.format = recording_nv12 ? PixelLayout::NV12 : PixelLayout::BGR;
+    // 移动侦测线程也会开始录制，界面线程读 record_sub 时用原子读取
+    std::atomic_store(&record_sub, bus.subscribe("recording", options));
+    
     // 重置停止标志
     stop_recording = false;
     is_recording = true;
@@ -165,25 +188,25 @@ void Monitor::start_async_recording(const std::string& filename, int codec, doub
     recording_thread = std::thread(&Monitor::recording_worker, this);
     
     // 如果还没有启动异步视频帧采集，启动它
-    if (!is_frame_grabbing_active()) {
-        start_frame_grabbing_function(fps);
-    }
+    ensure_frame_grabbing(fps);
 }
 
 // 停止异步录制
 void Monitor::stop_async_recording() {
-    if (is_recording) {
+    // 录制线程打不开文件时会自己结束（is_recording 已为 false），线程和订阅仍要回收；
+    // 移动侦测正在锁外结束录制时由它回收
+    if (!recording_stopping && recording_thread.joinable()) {
         // 设置停止标志
         stop_recording = true;
         
         // 通知可能在等待的录制线程
-        frame_cv.notify_one();
+        record_sub->wake();
         
         // 等待线程结束
-        if (recording_thread.joinable()) {
-            recording_thread.join();
-        }
+        recording_thread.join();
         
+        // 注销订阅；record_sub 保留到下次录制，供查询统计
+        bus.unsubscribe(record_sub);
         is_recording = false;
     }
 }
@@ -195,62 +218,278 @@ bool Monitor::is_recording_active() const {
 
 // 录制线程的工作函数
 void Monitor::recording_worker() {
-    cv::VideoWriter writer;
+    std::unique_ptr<VideoSink> writer;            // RecordingMode::Single
+    std::unique_ptr<SegmentedEncoder> segmented;  // RecordingMode::Segmented 时代替 writer
+    std::unique_ptr<RollingRecorder> rolling;     // RecordingMode::Rolling 时代替 writer
+    std::unique_ptr<MkvWriter> vfr;               // RecordingMode::Vfr 时代替 writer
     bool writer_initialized = false;
+    auto write_frame = [&](const TimedFrame& timed) {
+        if (rolling) {
+            rolling->write(timed.image, timed.meta.capture_ns);
+        } else if (segmented) {
+            segmented->write(timed.image);
+        } else if (vfr) {
+            vfr->write(timed.image, timed.meta.capture_ns);  // 用采集时间，不按 video_fps 推算
+        } else {
+            writer->write(timed.image);
+        }
+    };
 
     while (!stop_recording) {
         // 等待新帧或停止信号
-        std::unique_lock<std::mutex> lock(frame_mutex);
-        if (frame_queue.empty()) {
-            // 使用条件变量等待，超时1秒以检查停止标志
-            frame_cv.wait_for(lock, std::chrono::seconds(1), 
-                             [this]() { return !frame_queue.empty() || stop_recording; });
-            
+        // 超时1秒以检查停止标志
+        TimedFrame* slot = record_sub->wait_front(std::chrono::seconds(1));
+        if (slot == nullptr) {
             // 如果队列仍然为空且收到停止信号，结束循环
-            if (frame_queue.empty() && stop_recording) {
+            if (slot == nullptr && stop_recording) {
                 break;
             }
             
             // 如果只是超时，继续循环
-            if (frame_queue.empty()) {
+            if (slot == nullptr) {
                 continue;
             }
         }
         
-        // 获取队列中的帧
-        cv::Mat current_frame = frame_queue.front().clone();  // 使用clone避免引用问题
-        frame_queue.pop();
-        lock.unlock();
+        // 直接在槽位上编码，写完后归还槽位，内存留给采集线程复用
+        const cv::Mat& current_frame = slot->image;
         
         // 初始化VideoWriter（在第一帧可用时）
         if (!writer_initialized) {
-            writer.open(video_filename, video_codec, video_fps, 
-                       cv::Size(current_frame.cols, current_frame.rows));
-            
-            if (!writer.isOpened()) {
-                std::cerr << "无法创建视频文件：" << video_filename << std::endl;
-                is_recording = false;
-                return;
+            const cv::Size picture = video_frame_size(current_frame, recording_nv12);  // NV12 帧的行数是画面高度的 1.5 倍
+            if (recording_mode == RecordingMode::Rolling) {
+                // 每个分段关闭时（后台线程上）登记，不等整段录制结束
+                RollingOptions options = rolling_options;
+                options.nv12 = recording_nv12;
+                rolling.reset(new RollingRecorder(video_codec, video_fps, options, [this](const SegmentInfo& segment) {
+                    RecordInfo info;
+                    info.filename = segment.filename;
+                    info.start_time = segment.start_time;
+                    info.end_time = segment.end_time;
+                    register_recording(info);
+                }, [this](const std::string& filename) {
+                    // 保留策略删掉的分段同时从索引中去掉，查询和回放不会拿到已不存在的文件
+                    record_index->remove(camera_id, filename);
+                }));
+            } else if (recording_mode == RecordingMode::Segmented) {
+                // 分段并行编码：录制线程只负责切段，编码在线程池上进行
+                SegmentedEncoderOptions options = segment_options;
+                options.nv12 = recording_nv12;
+                segmented.reset(new SegmentedEncoder(video_filename, video_codec, video_fps, options));
+                std::cout << "分段并行编码：" << segmented->worker_count() << " 个线程，每段最多 "
+                          << segment_options.segment_frames << " 帧" << std::endl;
+            } else if (recording_mode == RecordingMode::Vfr) {
+                vfr.reset(new MkvWriter());
+                if (!vfr->open(video_filename, current_frame.size(), video_fps)) {
+                    std::cerr << "无法创建视频文件：" << video_filename << std::endl;
+                    is_recording = false;
+                    return;
+                }
+            } else {
+                writer = open_video_sink(video_filename, video_codec, video_fps, picture, recording_nv12);
+                if (!writer) {
+                    std::cerr << "无法创建视频文件：" << video_filename << std::endl;
+                    is_recording = false;
+                    return;
+                }
             }
             
             writer_initialized = true;
-            std::cout << "开始录制视频到：" << video_filename << std::endl;
+            std::cout << "开始录制视频到：" << video_filename
+                      << (recording_nv12 ? "（NV12 直接交给 ffmpeg 编码）" : "") << std::endl;
             record_info_temp.filename = video_filename;
             record_info_temp.start_time = std::chrono::system_clock::now();
 
+            // 先补上按下录制之前的几秒，再接第一帧实时帧（发布序号连续，不重不漏）
+            const int64_t preroll_start_ns = flush_preroll(slot->generation, picture, write_frame);
+            if (preroll_start_ns != 0) {
+                record_info_temp.start_time -= std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                    std::chrono::nanoseconds(slot->meta.capture_ns - preroll_start_ns));
+            }
         }
         
-        // 写入帧
-        writer.write(current_frame);
+        // 写入帧（分段模式下只增加引用计数，槽位内存仍可被采集线程安全复用）
+        write_frame(*slot);
+        record_sub->pop();
+    }
+    
+    // 写完停止前已经入队的帧
+    for (size_t pending = record_sub->size(); pending > 0; --pending) {
+        if (writer_initialized) {
+            write_frame(*record_sub->front());
+        }
+        record_sub->pop();
     }
     
     // 释放VideoWriter
-    if (writer_initialized) {
-        writer.release();
-        std::cout << "视频录制完成：" << video_filename << std::endl;
-        record_info_temp.end_time = std::chrono::system_clock::now();
-        record_info_queue.push(record_info_temp);
-        std::cout << "录制信息已保存到队列" << std::endl;
+    if (writer_initialized && rolling) {
+        // 关闭最后一个分段；各分段已经在关闭时分别登记
+        rolling->finish();
+        rolling.reset();
+        std::cout << "滚动录制结束" << std::endl;
+    } else if (writer_initialized) {
+        bool complete = true;  // 输出文件完整写出；不完整的文件不登记、不提示完成
+        if (segmented) {
+            // 等所有段编码完，按顺序拼接成 video_filename
+            complete = segmented->finish();
+            segmented.reset();
+        } else if (vfr) {
+            complete = vfr->close();
+            std::cout << "可变帧率录制：" << vfr->frames() << " 帧，" << vfr->duration_ms() / 1000.0 << " 秒" << std::endl;
+            vfr.reset();
+        } else {
+            complete = writer->release();
+            writer.reset();
+        }
+        if (complete) {
+            std::cout << "视频录制完成：" << video_filename << std::endl;
+            record_info_temp.end_time = std::chrono::system_clock::now();
+            register_recording(record_info_temp);
+        } else {
+            std::cerr << "录制未能完整写出，未登记：" << video_filename << std::endl;
+        }
+    }
+}
+
+int64_t Monitor::flush_preroll(uint64_t generation, const cv::Size& size,
+                               const std::function<void(const TimedFrame&)>& write_frame) {
+    if (!preroll) {
+        return 0;
+    }
+    // 回溯缓冲区异步压缩，按下录制前刚发布的几帧可能还在它的订阅队列里，等它们处理完再取，前后不留空档
+    if (!preroll->wait_until(generation, std::chrono::milliseconds(500))) {
+        std::cerr << "回溯缓冲区压缩未跟上，录制开头可能缺几帧" << std::endl;
+    }
+    std::vector<EncodedFrame> frames = preroll->frames_before(generation);
+    if (frames.empty()) {
+        return 0;
+    }
+    // 解码按批并行，录制线程只管编码；实时帧在录制队列里等着，
+    // 队列快满时放弃剩下的回溯帧，保证实时部分不丢
+    const size_t batch = std::max(1, cv::getNumThreads());
+    const size_t capacity = record_sub->stats().queue.capacity;
+    size_t written = 0;
+    int64_t first_ns = 0;
+    for (size_t start = 0; start < frames.size(); start += batch) {
+        if (record_sub->size() > capacity * 3 / 4) {
+            std::cerr << "录制追赶不及，放弃 " << frames.size() - start << " 帧回溯" << std::endl;
+            break;
+        }
+        const size_t count = std::min(batch, frames.size() - start);
+        std::vector<TimedFrame> decoded(count);
+        cv::parallel_for_(cv::Range(0, static_cast<int>(count)), [&](const cv::Range& range) {
+            for (int i = range.start; i < range.end; ++i) {
+                decoded[i].image = cv::imdecode(frames[start + i].jpeg, cv::IMREAD_COLOR);
+                decoded[i].meta = frames[start + i].meta;
+                decoded[i].generation = frames[start + i].generation;
+            }
+        });
+        for (const TimedFrame& timed : decoded) {
+            if (timed.image.size() != size) {
+                continue;  // 分辨率在回溯期间变过，旧尺寸的帧不能写进同一个文件
+            }
+            if (written++ == 0) {
+                first_ns = timed.meta.capture_ns;
+            }
+            write_frame(timed);
+        }
+    }
+    std::cout << "已写入 " << written << " 帧录制前回溯" << std::endl;
+    return first_ns;
+}
+
+void Monitor::enable_motion_recording(const MotionOptions& options) {
+    disable_motion_recording();
+    motion.configure(options);
+    if (options.preroll_seconds > 0 && options.preroll_seconds != preroll_seconds) {
+        set_preroll(options.preroll_seconds, preroll_quality);
+    }
+    stop_motion = false;
+    motion_enabled = true;
+    motion_thread = std::thread(&Monitor::motion_worker, this);
+    // 侦测在采集线程上运行，没有界面时也要有人采集
+    ensure_frame_grabbing(preview_fps);
+}
+
+void Monitor::disable_motion_recording() {
+    if (!motion_enabled) {
+        return;
+    }
+    motion_enabled = false;
+    stop_motion = true;
+    if (motion_thread.joinable()) {
+        motion_thread.join();
+    }
+}
+
+bool Monitor::begin_stop_recording_locked() {
+    if (recording_stopping || !recording_thread.joinable()) {
+        return false;
+    }
+    recording_stopping = true;
+    stop_recording = true;
+    record_sub->wake();
+    return true;
+}
+
+void Monitor::finish_stop_recording() {
+    // recording_stopping 期间只有这里访问 recording_thread
+    recording_thread.join();
+    std::lock_guard<std::mutex> lock(recording_control_mutex);
+    bus.unsubscribe(record_sub);
+    is_recording = false;
+    recording_stopping = false;
+}
+
+void Monitor::motion_worker() {
+    while (!stop_motion) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        const bool active = motion.active(monotonic_ns());
+        bool stopping = false;
+        {
+            std::lock_guard<std::mutex> lock(recording_control_mutex);
+            if (active && !is_recording && !recording_stopping) {
+                std::string filename = "motion_" + std::to_string(std::time(nullptr)) + recording_extension();
+                std::cout << "检测到移动，开始录制" << std::endl;
+                start_async_recording(filename, cv::VideoWriter::fourcc('a', 'v', 'c', '1'), grabbing_fps);
+                motion_recording = true;
+            } else if (!active && motion_recording) {
+                // 只停自己发起的录制，手动开始的录制不受影响
+                if (is_recording) {
+                    std::cout << "移动已停止，结束录制" << std::endl;
+                    stopping = begin_stop_recording_locked();
+                }
+                motion_recording = false;
+            }
+        }
+        // 在锁外等录制线程写完，界面线程照常响应
+        if (stopping) {
+            finish_stop_recording();
+        }
+    }
+    bool stopping = false;
+    {
+        std::lock_guard<std::mutex> lock(recording_control_mutex);
+        if (motion_recording && is_recording) {
+            stopping = begin_stop_recording_locked();
+        }
+        motion_recording = false;
+    }
+    if (stopping) {
+        finish_stop_recording();
+    }
+}
+
+void Monitor::set_preroll(double seconds, int quality) {
+    if (is_recording) {
+        std::cerr << "录制中不能修改回溯时长" << std::endl;
+        return;
+    }
+    preroll.reset();
+    preroll_seconds = seconds;
+    preroll_quality = quality;
+    if (preroll_seconds > 0) {
+        preroll.reset(new PrerollBuffer(bus, preroll_seconds, preroll_quality));
     }
 }
 
@@ -260,8 +499,42 @@ void Monitor::start_window() {
 }
 
 void Monitor::show_camera() {
-    // 显示摄像头图像
-    ImGui::Image((ImTextureID)(intptr_t)textureID, ImVec2(frame.cols, frame.rows));
+    // 显示摄像头图像；超时没有新帧时保留最后一帧并提示无信号
+    if (!frame.empty() && uploader.texture_id() != 0) {
+        ImGui::Image((ImTextureID)(intptr_t)uploader.texture_id(), ImVec2(frame.cols, frame.rows));
+    }
+    if (is_frame_grabbing && !playback.is_open() && is_feed_stale()) {
+        if (last_frame_ns == 0) {
+            ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "NO SIGNAL");
+        } else {
+            ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "NO SIGNAL (%.1f s)",
+                               (monotonic_ns() - last_frame_ns) / 1e9);
+        }
+    }
+    // 丢帧来源：帧源（传感器/总线/驱动）、抽帧、录制队列裁剪
+    CaptureStats stats = get_capture_stats();
+    ImGui::Text("seq %llu  drops: source %llu, queue %llu",
+                static_cast<unsigned long long>(frame_meta.sequence),
+                static_cast<unsigned long long>(stats.source_drops),
+                static_cast<unsigned long long>(stats.queue_drops));
+    if (motion_enabled) {
+        // 侦测开销按当前采集帧率折算成单核占用
+        MotionStats motion_stats = motion.stats();
+        ImGui::Text("motion: score %.3f, %.1f us/frame (%.2f%% core)%s", motion_stats.last_score,
+                    motion_stats.avg_cost_us, motion_stats.avg_cost_us * grabbing_fps / 1e4,
+                    motion.active(monotonic_ns()) ? "  ACTIVE" : "");
+    }
+    const UploadStats& upload = uploader.stats();
+    ImGui::Text("upload [%s]: %.2f ms, stalls %llu, saved %llu", upload_path_name(uploader.get_path()),
+                upload.last_copy_ms, static_cast<unsigned long long>(upload.fence_stalls),
+                static_cast<unsigned long long>(upload.skipped));
+    std::shared_ptr<FrameSubscription> recording = std::atomic_load(&record_sub);
+    if (is_recording && recording) {
+        QueueStats queue = recording->stats().queue;
+        ImGui::Text("rec queue [%s]: %zu/%zu, peak %zu, %.1f MB",
+                    backpressure_policy_name(record_policy), queue.depth, queue.capacity,
+                    queue.high_water, queue.bytes_buffered / (1024.0 * 1024.0));
+    }
 }
 void Monitor::end_window() {
     // 结束窗口
@@ -270,10 +543,14 @@ void Monitor::end_window() {
 
 // 录制视频
 void Monitor::record() {
+    std::lock_guard<std::mutex> lock(recording_control_mutex);
+    if (recording_stopping) {
+        return;  // 移动侦测正在结束录制，结束后再按
+    }
     if (!is_recording_active()) {
         // 开始录制
         std::string filename = "recording_" + 
-            std::to_string(std::time(nullptr)) + ".mp4";  // 使用时间戳作为文件名
+            std::to_string(std::time(nullptr)) + recording_extension();  // 使用时间戳作为文件名
         start_async_recording(filename);
     } else {
         // 停止录制
@@ -283,11 +560,22 @@ void Monitor::record() {
 
 // 开始异步视频帧采集
 void Monitor::start_frame_grabbing_function(double fps) {
+    std::lock_guard<std::mutex> lock(grabber_mutex);
     // 如果已经在采集，先停止
     if (is_frame_grabbing) {
-        stop_frame_grabbing_function();
+        stop_grabber_locked();
     }
-    
+    start_grabber_locked(fps);
+}
+
+void Monitor::ensure_frame_grabbing(double fps) {
+    std::lock_guard<std::mutex> lock(grabber_mutex);
+    if (!is_frame_grabbing) {
+        start_grabber_locked(fps);
+    }
+}
+
+void Monitor::start_grabber_locked(double fps) {
     grabbing_fps = fps;
     
     // 重置停止标志
@@ -300,9 +588,17 @@ void Monitor::start_frame_grabbing_function(double fps) {
 
 // 停止异步视频帧采集
 void Monitor::stop_frame_grabbing_function() {
+    std::lock_guard<std::mutex> lock(grabber_mutex);
+    stop_grabber_locked();
+}
+
+void Monitor::stop_grabber_locked() {
     if (is_frame_grabbing) {
-        // 设置停止标志
+        // 设置停止标志，并唤醒可能正在等待设备的采集线程
         stop_frame_grabbing = true;
+        if (camera != nullptr) {
+            camera->wake();
+        }
         
         // 等待线程结束
         if (frame_grabber_thread.joinable()) {
@@ -321,67 +617,206 @@ bool Monitor::is_frame_grabbing_active() const {
 // 异步视频帧采集线程的工作函数
 void Monitor::frame_grabber_worker() {
     if (camera == nullptr) {
-        camera = new Camera(device_path);
+        camera = create_frame_source(device_path);
     }
     
-    // 计算帧之间的时间间隔（微秒）
-    const int64_t frame_interval_us = static_cast<int64_t>(1000000.0 / grabbing_fps);
-    
-    // 用于帧率控制的时间点
-    auto next_frame_time = std::chrono::high_resolution_clock::now();
+    // 节拍由设备决定：acquire_frame 只在有新帧或被 wake() 时返回。
+    // grabbing_fps 低于设备帧率时按到达时间抽帧，允许半个间隔的抖动
+    const auto frame_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / grabbing_fps));
+    auto next_frame_time = std::chrono::steady_clock::now();
     
     while (!stop_frame_grabbing) {
-        // 获取一帧视频
-        cv::Mat grabbed_frame;
-        camera->capture_frame(grabbed_frame);
-        
-        {
-            // 锁定以更新共享的frame
-            std::lock_guard<std::mutex> lock(frame_mutex);
-            frame = grabbed_frame.clone();
-        }
-        
-        // 如果正在录制，将帧添加到队列
-        if (is_recording) {
-            std::unique_lock<std::mutex> lock(frame_mutex);
-            
-            // 限制队列大小，防止内存溢出
-            if (frame_queue.size() > 90) {  // 增加到90帧缓冲，约3秒@30fps
-                frame_queue.pop();
+        // 以租约形式取得一帧（直接引用 mmap 缓冲区）
+        FrameLease lease;
+        if (!camera->acquire_frame(lease)) {
+            // 设备未就绪或已拔出时 acquire_frame 会立即失败，稍等再试，避免空转
+            if (!stop_frame_grabbing) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(camera->is_open() ? 10 : 100));
             }
-            
-            frame_queue.push(grabbed_frame.clone());
-            lock.unlock();
-            
-            // 通知录制线程有新帧可用
-            frame_cv.notify_one();
+            continue;
         }
+        auto now = std::chrono::steady_clock::now();
+        if (burst->is_capturing() || burst->get_history() > 0) {
+            next_frame_time = now;  // 连拍按传感器全帧率，结束后从当前时刻重新开始抽帧
+        } else if (now + frame_interval / 2 < next_frame_time) {
+            ++decimated_frames;
+            continue;  // 抽帧：lease 离开作用域后立即归还
+        }
+        next_frame_time = std::max(next_frame_time + frame_interval, now);
+
+        // 移动侦测直接读租约里的 Y 采样，不等颜色转换
+        if (motion_enabled) {
+            motion.process(lease);
+        }
+
+        // 分发给所有订阅者：每种格式只转换一次，同格式的订阅者共享内存
+        bus.publish(lease);
+        lease.release();  // 转换完成后立即归还缓冲区给驱动
         
-        // 计算下一帧的时间点
-        next_frame_time += std::chrono::microseconds(frame_interval_us);
-        
-        // 睡眠到下一帧的时间点
-        auto now = std::chrono::high_resolution_clock::now();
-        if (now < next_frame_time) {
-            std::this_thread::sleep_until(next_frame_time);
-        } else {
-            // 如果已经错过了预定时间，调整下一帧时间点以避免积累延迟
-            next_frame_time = now + std::chrono::microseconds(frame_interval_us);
+        // 显示有新帧了：唤醒按需渲染的 UI 主循环
+        void (*notify)() = frame_notifier.load();
+        if (notify != nullptr && display_sub->has_fresh()) {
+            notify();
         }
     }
 }
 
 void Monitor::capture_button(){
     if(ImGui::Button("Capture")) {
-        //尚未做拍照逻辑
+        // 拍下当前显示的帧；编码和写文件在后台，连拍也不影响界面和采集
+        takephoto();
+    }
+    std::lock_guard<std::mutex> lock(photo_status_mutex);
+    if (!photo_status.empty()) {
+        ImGui::SameLine();
+        ImGui::TextUnformatted(photo_status.c_str());
+    }
+    
+    if (ImGui::Button("Burst")) {
+        start_burst(burst_frames, burst_options);
+    }
+    if (burst->get_history() > 0) {
+        ImGui::SameLine();
+        if (ImGui::Button("Last")) {
+            capture_last_frames(burst_frames, burst_options);
+        }
+    }
+    const BurstProgress progress = burst->progress();
+    switch (progress.state) {
+    case BurstState::Capturing:
+        ImGui::Text("burst: %zu/%zu frames", progress.captured, progress.requested);
+        break;
+    case BurstState::Encoding:
+        ImGui::Text("burst: saving %zu/%zu", progress.encoded + progress.failed, progress.captured);
+        break;
+    case BurstState::Done:
+        ImGui::Text("burst: %zu frames over %.0f ms (missed %llu), saved in %.0f ms",
+                    progress.encoded, progress.span_ms, static_cast<unsigned long long>(progress.missed),
+                    progress.encode_ms);
+        ImGui::TextUnformatted(progress.directory.c_str());
+        break;
+    case BurstState::Failed:
+        ImGui::TextUnformatted("burst failed");
+        break;
+    case BurstState::Idle:
+        break;
+    }
+}
 
-        // 捕获当前帧
-        camera->capture_frame(frame);
-        
-        // 显示捕获的帧
-        ImGui::Image((ImTextureID)(intptr_t)textureID, ImVec2(frame.cols, frame.rows));
+std::future<PhotoResult> Monitor::takephoto(std::function<void(const PhotoResult&)> done) {
+    if (!photos) {
+        photos.reset(new PhotoEncoder(photo_options));
     }
+    // 用户看到的那一帧：frame 与 UI 上显示的一致（回放时是回放帧）；还没有显示过任何帧时取信箱里最新的
+    if (frame.empty()) {
+        take_latest_frame();
+    }
+    return photos->submit(frame, frame_meta, [this, done](const PhotoResult& result) {
+        {
+            std::lock_guard<std::mutex> lock(photo_status_mutex);
+            photo_status = result.ok ? result.path : "photo failed";
+        }
+        if (done) {
+            done(result);
+        }
+    });
 }
+
+bool Monitor::start_burst(size_t frames, const BurstOptions& options) {
+    if (!burst->start_next(frames, options)) {
+        return false;
+    }
+    // 订阅已挂上：采集线程从下一帧起不再抽帧。没有在采集（例如正在回放）时为连拍启动采集，
+    // 收齐之前 stop_preview() 不会停掉它
+    ensure_frame_grabbing(preview_fps);
+    return true;
+}
+
+bool Monitor::capture_last_frames(size_t frames, const BurstOptions& options) {
+    return burst->start_last(frames, options);
+}
+
+void Monitor::set_photo_options(const PhotoOptions& options) {
+    photo_options = options;
+    photos.reset();  // 析构时等已提交的照片写完
+}
+void Monitor::playback_controls() {
+    if (!playback.is_open()) {
+        if (ImGui::Button("Playback")) {
+            // 回放最近一天里最新的一段录像
+            const auto now = std::chrono::system_clock::now();
+            std::vector<RecordInfo> recent = find_recordings(now - std::chrono::hours(24), now);
+            if (!recent.empty()) {
+                open_playback(recent.back().filename);
+            }
+        }
+        return;
+    }
+    ImGui::Text("playback: %s", playback.filename().c_str());
+    if (playback.has_failed() || !playback.is_ready()) {
+        ImGui::TextUnformatted(playback.has_failed() ? "cannot play this file" : "indexing...");
+    } else {
+        float position = playback.position_ms() / 1000.0f;
+        if (ImGui::SliderFloat("##position", &position, 0.0f, playback.duration_ms() / 1000.0f, "%.1f s")) {
+            playback.seek(static_cast<int64_t>(position * 1000.0f));
+        }
+        if (ImGui::Button(playback.is_playing() ? "Pause" : "Play")) {
+            if (playback.is_playing()) {
+                playback.pause();
+            } else {
+                playback.play();
+            }
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("<")) {
+            playback.step(-1);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button(">")) {
+            playback.step(1);
+        }
+        static const double speeds[] = {0.5, 1.0, 2.0, 4.0, 8.0, 16.0};
+        static const char* labels[] = {"0.5x", "1x", "2x", "4x", "8x", "16x"};
+        const double speed = playback.get_speed();
+        for (int i = 0; i < 6; ++i) {
+            ImGui::SameLine();
+            if (ImGui::RadioButton(labels[i], speed == speeds[i])) {
+                playback.set_speed(speeds[i]);
+            }
+        }
+        PlaybackStats stats = playback.stats();
+        ImGui::Text("decoded %llu, late %llu, seeks %llu, buffered %zu",
+                    static_cast<unsigned long long>(stats.decoded), static_cast<unsigned long long>(stats.late),
+                    static_cast<unsigned long long>(stats.seeks), stats.buffered);
+    }
+    if (ImGui::Button("Live")) {
+        close_playback();
+    }
+}
+
+bool Monitor::open_playback(const std::string& filename, int64_t start_ms) {
+    if (!playback.open(filename)) {
+        return false;
+    }
+    if (start_ms > 0) {
+        playback.seek(start_ms);
+    }
+    return true;
+}
+
+bool Monitor::open_playback_at(std::chrono::system_clock::time_point time) {
+    std::vector<RecordInfo> found = find_recordings(time, time);
+    if (found.empty()) {
+        std::cerr << "这个时刻没有录像" << std::endl;
+        return false;
+    }
+    // 有重叠时取最晚开始的一段（滚动录制换段时前后两段会有极短的重叠）
+    const RecordInfo& info = found.back();
+    const int64_t offset_ms = std::chrono::duration_cast<std::chrono::milliseconds>(time - info.start_time).count();
+    return open_playback(info.filename, offset_ms);
+}
+
 void Monitor::record_button(){
     if(ImGui::Button("Record")) {
         // 录制视频
@@ -389,21 +824,78 @@ void Monitor::record_button(){
     }
 }
 bool Monitor::get_latest_recorded_frame(cv::Mat& out_frame) {
-    std::lock_guard<std::mutex> lock(frame_mutex);
-    if (!frame_queue.empty()) {
-        out_frame = frame_queue.back().clone();
+    // 录制环只属于采集线程和录制线程，这里从显示信箱取最新帧（只能在 UI 线程调用）
+    take_latest_frame();
+    if (is_recording && !frame.empty()) {
+        if (frame.channels() == 4) {
+            cv::cvtColor(frame, out_frame, cv::COLOR_BGRA2BGR);  // 显示帧是 BGRA，对外仍给 BGR
+        } else {
+            out_frame = frame;  // 共享只读数据，不再 clone
+        }
         return true;
     }
     return false;
 }
 
-std::vector<RecordInfo> Monitor::get_all_record_info() {
-    std::lock_guard<std::mutex> lock(record_info_mutex);
+CaptureStats Monitor::get_capture_stats() const {
+    CaptureStats stats;
+    stats.source_drops = camera != nullptr ? camera->dropped_frames() : 0;
+    stats.decimated = decimated_frames.load();
+    std::shared_ptr<FrameSubscription> recording = std::atomic_load(&record_sub);
+    stats.queue_drops = recording ? recording->stats().queue.dropped : 0;
+    return stats;
+}
+
+void Monitor::set_recording_backpressure(BackpressurePolicy policy, int block_timeout_ms) {
+    record_policy = policy;
+    record_block_timeout_ms = block_timeout_ms;
+    std::shared_ptr<FrameSubscription> recording = std::atomic_load(&record_sub);
+    if (recording) {
+        recording->set_policy(policy, block_timeout_ms);
+    }
+}
+
+QueueStats Monitor::get_recording_queue_stats() const {
+    std::shared_ptr<FrameSubscription> recording = std::atomic_load(&record_sub);
+    return recording ? recording->stats().queue : QueueStats();
+}
+
+static int64_t to_unix_ms(std::chrono::system_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+}
+
+void Monitor::register_recording(const RecordInfo& info) {
+    RecordingEntry entry;
+    entry.camera = camera_id;
+    entry.start_ms = to_unix_ms(info.start_time);
+    entry.end_ms = to_unix_ms(info.end_time);
+    entry.filename = info.filename;
+    std::error_code ec;
+    entry.bytes = std::filesystem::file_size(info.filename, ec);
+    if (ec) {
+        entry.bytes = 0;
+    }
+    if (record_index && record_index->append(entry)) {
+        std::cout << "录制信息已写入索引" << std::endl;
+    }
+}
+
+std::vector<RecordInfo> Monitor::find_recordings(std::chrono::system_clock::time_point from,
+                                                 std::chrono::system_clock::time_point to) {
     std::vector<RecordInfo> infos;
-    std::queue<RecordInfo> temp = record_info_queue;
-    while (!temp.empty()) {
-        infos.push_back(temp.front());
-        temp.pop();
+    if (!record_index) {
+        return infos;
+    }
+    for (const RecordingEntry& entry : record_index->query(camera_id, to_unix_ms(from), to_unix_ms(to))) {
+        RecordInfo info;
+        info.filename = entry.filename;
+        info.start_time = std::chrono::system_clock::time_point(std::chrono::milliseconds(entry.start_ms));
+        info.end_time = std::chrono::system_clock::time_point(std::chrono::milliseconds(entry.end_ms));
+        infos.push_back(info);
     }
     return infos;
+}
+
+std::vector<RecordInfo> Monitor::get_all_record_info() {
+    return find_recordings(std::chrono::system_clock::time_point::min(), std::chrono::system_clock::time_point::max());
 }
\ No newline at end of file
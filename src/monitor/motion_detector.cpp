@@ -0,0 +1,119 @@
+#include "motion_detector.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+// 背景建立期间的帧数，期间不报告移动（自动曝光、白平衡仍在收敛）
+static const int kWarmupFrames = 15;
+
+void MotionDetector::configure(const MotionOptions& options) {
+    std::lock_guard<std::mutex> lock(options_mutex);
+    this->options = options;
+    background.clear();  // 网格尺寸或阈值变了，背景重新建立
+    warmup = 0;
+}
+
+MotionOptions MotionDetector::get_options() const {
+    std::lock_guard<std::mutex> lock(options_mutex);
+    return options;
+}
+
+bool MotionDetector::process(const FrameLease& lease) {
+    if (!lease) {
+        return false;
+    }
+    const uint32_t format = lease->pixelformat;
+    if (format == V4L2_PIX_FMT_YUYV) {
+        const size_t stride = lease->stride ? lease->stride : static_cast<size_t>(lease->width) * 2;
+        return analyse(lease.data(), 2, stride, lease->width, lease->height, lease->meta.capture_ns);
+    }
+    if (is_semi_planar(format)) {
+        const FramePlane& y = lease->planes[0];
+        return analyse(static_cast<const uint8_t*>(y.data), 1, y.stride, lease->width, lease->height,
+                       lease->meta.capture_ns);
+    }
+    // 压缩格式没有现成的亮度采样，为侦测而解码就失去了意义
+    if (!warned_format) {
+        std::cerr << "移动侦测不支持当前像素格式，需要 YUYV/NV12/NV16" << std::endl;
+        warned_format = true;
+    }
+    return false;
+}
+
+bool MotionDetector::analyse(const uint8_t* y, size_t pixel_step, size_t row_stride, int width, int height,
+                             int64_t capture_ns) {
+    if (y == nullptr || width <= 0 || height <= 0) {
+        return false;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(options_mutex);
+
+    const int gw = std::max(1, std::min(options.grid_width, width));
+    const int gh = std::max(1, std::min(height, height * gw / width));
+    if (gw != grid_w || gh != grid_h || background.size() != static_cast<size_t>(gw) * gh) {
+        grid_w = gw;
+        grid_h = gh;
+        background.assign(static_cast<size_t>(gw) * gh, 0);
+        warmup = 0;
+    }
+    const int cell_w = width / gw;
+    const int cell_h = height / gh;
+    const int alpha = std::max(1, static_cast<int>(options.background_rate * 256));  // 8 位小数
+    const int threshold = options.pixel_threshold << 8;
+
+    // 每个单元取 2x2 个采样的平均：比逐像素缩放便宜得多，又能压住传感器噪声
+    int changed = 0;
+    for (int gy = 0; gy < gh; ++gy) {
+        const uint8_t* row0 = y + static_cast<size_t>(gy * cell_h + cell_h / 4) * row_stride;
+        const uint8_t* row1 = y + static_cast<size_t>(gy * cell_h + cell_h * 3 / 4) * row_stride;
+        uint16_t* bg = &background[static_cast<size_t>(gy) * gw];
+        for (int gx = 0; gx < gw; ++gx) {
+            const size_t x0 = static_cast<size_t>(gx * cell_w + cell_w / 4) * pixel_step;
+            const size_t x1 = static_cast<size_t>(gx * cell_w + cell_w * 3 / 4) * pixel_step;
+            const int value = (row0[x0] + row0[x1] + row1[x0] + row1[x1]) << 6;  // 平均值，8.8 定点
+            if (warmup == 0) {
+                bg[gx] = static_cast<uint16_t>(value);
+                continue;
+            }
+            const int diff = value - bg[gx];
+            if (std::abs(diff) > threshold) {
+                ++changed;
+            }
+            bg[gx] = static_cast<uint16_t>(bg[gx] + diff * alpha / 256);
+        }
+    }
+
+    const double score = static_cast<double>(changed) / (gw * gh);
+    const bool motion = warmup >= kWarmupFrames && score >= options.sensitivity;
+    if (warmup < kWarmupFrames) {
+        ++warmup;
+    }
+    if (motion) {
+        last_motion_ns = capture_ns;
+        ++motion_count;
+    }
+    ++frame_count;
+    last_score = score;
+    const double cost = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    avg_cost_us = frame_count == 1 ? cost : avg_cost_us * 0.95 + cost * 0.05;
+    return motion;
+}
+
+bool MotionDetector::active(int64_t now_ns) const {
+    const int64_t last = last_motion_ns.load();
+    if (last == 0) {
+        return false;
+    }
+    const double hold = get_options().hold_seconds;
+    return now_ns - last <= static_cast<int64_t>(hold * 1e9);
+}
+
+MotionStats MotionDetector::stats() const {
+    MotionStats stats;
+    stats.frames = frame_count.load();
+    stats.motion_frames = motion_count.load();
+    stats.last_score = last_score.load();
+    stats.avg_cost_us = avg_cost_us.load();
+    return stats;
+}
@@ -0,0 +1,141 @@
+#include "photo_encoder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+PhotoEncoder::PhotoEncoder(const PhotoOptions& options) : options(options) {
+    std::error_code ec;
+    std::filesystem::create_directories(this->options.directory, ec);
+    const int worker_count = std::max(1, this->options.workers);
+    for (int i = 0; i < worker_count; ++i) {
+        workers.emplace_back(&PhotoEncoder::worker_loop, this);
+    }
+}
+
+PhotoEncoder::~PhotoEncoder() {
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        stopping = true;
+    }
+    jobs_cv.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+std::string PhotoEncoder::next_path() {
+    // 连拍时同一毫秒内也不重名：时间戳加递增序号
+    const auto now = std::chrono::system_clock::now();
+    const std::time_t t = std::chrono::system_clock::to_time_t(now);
+    const int ms = static_cast<int>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000);
+    std::tm tm;
+    localtime_r(&t, &tm);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &tm);
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), "_%03d_%04llu", ms, static_cast<unsigned long long>(++counter));
+    return (std::filesystem::path(options.directory) / (options.prefix + "_" + stamp + suffix + options.extension)).string();
+}
+
+std::future<PhotoResult> PhotoEncoder::submit(const cv::Mat& image, const FrameMeta& meta,
+                                              std::function<void(const PhotoResult&)> done) {
+    Job job;
+    job.image = image;  // 共享像素：帧源发现缓冲区仍被引用时会另分配，不会改写这一帧
+    job.result.meta = meta;
+    job.done = std::move(done);
+    std::future<PhotoResult> future = job.promise.get_future();
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        if (!image.empty() && !stopping && pending < options.max_pending) {
+            job.result.path = next_path();
+            jobs.push_back(std::move(job));
+            ++pending;
+            jobs_cv.notify_one();
+            return future;
+        }
+    }
+    // 拒绝：调用方从不等待编码线程
+    ++rejected_count;
+    if (job.done) {
+        job.done(job.result);
+    }
+    job.promise.set_value(job.result);
+    return future;
+}
+
+bool PhotoEncoder::encode(Job& job) {
+    cv::Mat bgr;
+    if (job.image.channels() == 4) {
+        cv::cvtColor(job.image, bgr, cv::COLOR_BGRA2BGR);  // 显示帧是 BGRA
+    } else {
+        bgr = job.image;
+    }
+    job.image.release();  // 尽早把缓冲区还给帧源
+
+    std::vector<int> params;
+    if (options.extension == ".png") {
+        params = {cv::IMWRITE_PNG_COMPRESSION, options.png_compression};
+    } else {
+        params = {cv::IMWRITE_JPEG_QUALITY, options.jpeg_quality};
+    }
+    std::vector<uchar> encoded;
+    if (!cv::imencode(options.extension, bgr, encoded, params)) {
+        return false;
+    }
+    const std::string temp = job.result.path + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+        if (!out.good()) {
+            std::remove(temp.c_str());
+            return false;
+        }
+    }
+    return std::rename(temp.c_str(), job.result.path.c_str()) == 0;
+}
+
+void PhotoEncoder::worker_loop() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(jobs_mutex);
+            jobs_cv.wait(lock, [&]() { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;  // 停止时先写完排队的照片
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        const auto start = std::chrono::steady_clock::now();
+        job.result.ok = encode(job);
+        job.result.encode_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (job.result.ok) {
+            ++saved_count;
+        } else {
+            ++failed_count;
+            std::cerr << "照片保存失败：" << job.result.path << std::endl;
+        }
+        if (job.done) {
+            job.done(job.result);
+        }
+        job.promise.set_value(job.result);
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        --pending;
+    }
+}
+
+PhotoStats PhotoEncoder::stats() {
+    PhotoStats stats;
+    stats.saved = saved_count.load();
+    stats.failed = failed_count.load();
+    stats.rejected = rejected_count.load();
+    std::lock_guard<std::mutex> lock(jobs_mutex);
+    stats.pending = pending;
+    return stats;
+}
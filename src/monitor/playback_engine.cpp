@@ -0,0 +1,456 @@
+#include "playback_engine.h"
+#include "frame_lease.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char kMagic[8] = {'M', 'O', 'N', 'K', 'F', 'I', '1', '\0'};
+const double kKeyframeOnlySpeed = 2.0;  // 超过这个倍速只解码关键帧
+
+struct SidecarHeader {
+    char magic[8];
+    uint64_t video_bytes;
+    int64_t video_mtime_ns;
+    double fps;
+    uint64_t frames;
+};
+
+// 录像的大小和修改时间，用来判断 .kfi 是否过期
+bool video_signature(const std::string& video, uint64_t& bytes, int64_t& mtime_ns) {
+    struct stat st;
+    if (::stat(video.c_str(), &st) != 0) {
+        return false;
+    }
+    bytes = static_cast<uint64_t>(st.st_size);
+    mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+}  // namespace
+
+bool KeyframeIndex::build(const std::string& video, const std::atomic<bool>* cancel) {
+    // 原始模式：grab() 只读出压缩包，不解码，一小时的录像也只是顺序读一遍文件
+    cv::VideoCapture capture(video, cv::CAP_FFMPEG, {cv::CAP_PROP_FORMAT, -1});
+    if (!capture.isOpened()) {
+        return false;
+    }
+    fps = capture.get(cv::CAP_PROP_FPS);
+    if (fps <= 0) {
+        fps = 30.0;
+    }
+    std::vector<std::pair<int64_t, bool>> packets;  // 解码顺序的（显示时间，是否关键帧）
+    bool any_key = false;
+    while (capture.grab()) {
+        if (cancel != nullptr && packets.size() % 64 == 0 && cancel->load()) {
+            return false;
+        }
+        const int64_t ms = std::llround(capture.get(cv::CAP_PROP_POS_MSEC));
+        const bool key = capture.get(cv::CAP_PROP_LRF_HAS_KEY_FRAME) != 0;
+        any_key = any_key || key;
+        packets.push_back({ms, key});
+    }
+    if (packets.empty()) {
+        return false;
+    }
+    // 有 B 帧时解码顺序与显示顺序不同，按显示时间排序；关键帧总是 GOP 里最早显示的
+    std::stable_sort(packets.begin(), packets.end(),
+                     [](const std::pair<int64_t, bool>& a, const std::pair<int64_t, bool>& b) { return a.first < b.first; });
+    if (!any_key) {
+        // 后端不报告关键帧：每帧都交给 VideoCapture 自己定位
+        std::cerr << "录像没有关键帧信息，按全部为关键帧处理：" << video << std::endl;
+    }
+
+    pts_ms.clear();
+    keyframes.clear();
+    keyframe_of.clear();
+    const int64_t origin = packets.front().first;
+    for (size_t i = 0; i < packets.size(); ++i) {
+        int64_t ms = packets[i].first - origin;
+        if (!pts_ms.empty() && ms <= pts_ms.back()) {
+            ms = pts_ms.back() + 1;  // 没有时间戳的流：保持严格递增
+        }
+        pts_ms.push_back(ms);
+        if (i == 0 || packets[i].second || !any_key) {
+            keyframes.push_back(static_cast<uint32_t>(i));
+        }
+        keyframe_of.push_back(keyframes.back());
+    }
+    return true;
+}
+
+bool KeyframeIndex::load(const std::string& sidecar, const std::string& video) {
+    uint64_t bytes;
+    int64_t mtime_ns;
+    if (!video_signature(video, bytes, mtime_ns)) {
+        return false;
+    }
+    std::ifstream in(sidecar, std::ios::binary);
+    SidecarHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.video_bytes != bytes ||
+        header.video_mtime_ns != mtime_ns || header.frames == 0) {
+        return false;
+    }
+    fps = header.fps;
+    pts_ms.resize(header.frames);
+    std::vector<uint8_t> key(header.frames);
+    if (!in.read(reinterpret_cast<char*>(pts_ms.data()), pts_ms.size() * sizeof(int64_t)) ||
+        !in.read(reinterpret_cast<char*>(key.data()), key.size())) {
+        pts_ms.clear();
+        return false;
+    }
+    keyframes.clear();
+    keyframe_of.clear();
+    for (size_t i = 0; i < key.size(); ++i) {
+        if (i == 0 || key[i]) {
+            keyframes.push_back(static_cast<uint32_t>(i));
+        }
+        keyframe_of.push_back(keyframes.back());
+    }
+    return true;
+}
+
+bool KeyframeIndex::save(const std::string& sidecar, const std::string& video) const {
+    SidecarHeader header = {};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    if (!video_signature(video, header.video_bytes, header.video_mtime_ns)) {
+        return false;
+    }
+    header.fps = fps;
+    header.frames = pts_ms.size();
+    std::vector<uint8_t> key(pts_ms.size(), 0);
+    for (uint32_t frame : keyframes) {
+        key[frame] = 1;
+    }
+    std::ofstream out(sidecar, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(pts_ms.data()), pts_ms.size() * sizeof(int64_t));
+    out.write(reinterpret_cast<const char*>(key.data()), key.size());
+    return out.good();
+}
+
+uint32_t KeyframeIndex::frame_at(int64_t ms) const {
+    auto it = std::upper_bound(pts_ms.begin(), pts_ms.end(), ms);
+    return it == pts_ms.begin() ? 0 : static_cast<uint32_t>(it - pts_ms.begin() - 1);
+}
+
+uint32_t KeyframeIndex::next_keyframe(uint32_t frame) const {
+    auto it = std::lower_bound(keyframes.begin(), keyframes.end(), frame);
+    return it == keyframes.end() ? static_cast<uint32_t>(frames()) : *it;
+}
+
+PlaybackEngine::PlaybackEngine(size_t depth) : depth(std::max<size_t>(depth, 2)) {}
+
+PlaybackEngine::~PlaybackEngine() {
+    close();
+}
+
+bool PlaybackEngine::open(const std::string& path) {
+    close();
+    if (access(path.c_str(), R_OK) != 0) {
+        std::cerr << "无法打开录像：" << path << std::endl;
+        return false;
+    }
+    this->path = path;
+    stopping = false;
+    cancel_index = false;
+    ready = false;
+    failed = false;
+    finished = false;
+    playing = false;
+    shown = false;
+    speed = 1.0;
+    start_ms = 0;
+    ring.clear();
+    counters = PlaybackStats();
+    request_seek(0, true);
+    worker = std::thread(&PlaybackEngine::run, this);
+    return true;
+}
+
+void PlaybackEngine::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cancel_index = true;
+    wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    ring.clear();
+}
+
+void PlaybackEngine::run() {
+    const std::string sidecar = path + ".kfi";
+    index = KeyframeIndex();
+    if (!index.load(sidecar, path)) {
+        std::cout << "建立回放帧索引：" << path << std::endl;
+        if (index.build(path, &cancel_index) && !index.save(sidecar, path)) {
+            std::cerr << "无法保存帧索引：" << sidecar << std::endl;
+        }
+        if (cancel_index) {
+            return;  // 建索引期间被 close()，不再打开解码器
+        }
+    }
+    cv::VideoCapture capture(path);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed = index.frames() == 0 || !capture.isOpened();
+        ready = !failed;
+        if (failed) {
+            std::cerr << "无法回放：" << path << std::endl;
+            return;
+        }
+        if (start_ms > 0) {
+            request_seek(index.frame_at(start_ms), true);
+        }
+    }
+
+    const uint32_t frames = static_cast<uint32_t>(index.frames());
+    uint32_t next = 0;     // 解码器下一次 read() 得到的帧
+    uint32_t produce = 0;  // 下一个放进帧环的帧
+    bool exact = true;     // 定位后第一帧按请求的帧解码，不对齐到关键帧
+    while (true) {
+        double current_speed;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopping || seek_pending || (ring.size() < depth && produce < frames); });
+            if (stopping) {
+                return;
+            }
+            if (seek_pending) {
+                seek_pending = false;
+                produce = std::min(seek_frame, frames - 1);
+                exact = true;
+                finished = false;
+            }
+            current_speed = speed;
+        }
+
+        const bool keyframes_only = current_speed > kKeyframeOnlySpeed;
+        uint32_t target = produce;
+        if (keyframes_only && !exact) {
+            target = index.next_keyframe(produce);
+        }
+        exact = false;
+        if (target >= frames) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!seek_pending) {
+                produce = frames;
+                finished = true;
+            }
+            continue;
+        }
+        bool resync = false;  // 定位后解码器的位置要从时间戳确认
+        if (target != next) {
+            // 往回走，或者中间隔着关键帧：跳到目标所属的关键帧；同一 GOP 内向前只需继续解码。
+            // 按时间定位：FFmpeg 后端把帧号按标称帧率换算成时间，可变帧率的录像会落到别的帧上
+            const uint32_t key = index.keyframe_of[target];
+            if (target < next || key > next) {
+                capture.set(cv::CAP_PROP_POS_MSEC, static_cast<double>(index.pts_ms[key]));
+                resync = true;
+                std::lock_guard<std::mutex> lock(mutex);
+                ++counters.seeks;
+            }
+        }
+        // 逐帧 grab 到目标帧，只解出最后一帧；定位后第一帧按它的时间戳在索引里找到帧号
+        bool ok = true;
+        uint32_t decoded = next;
+        while (true) {
+            if (!capture.grab()) {
+                ok = false;
+                break;
+            }
+            if (resync) {
+                decoded = index.frame_at(std::llround(capture.get(cv::CAP_PROP_POS_MSEC)));
+                resync = false;
+            } else {
+                decoded = next;
+            }
+            next = decoded + 1;
+            if (decoded >= target) {
+                break;
+            }
+        }
+        cv::Mat image;
+        ok = ok && decoded < frames && capture.retrieve(image) && !image.empty();
+        if (ok) {
+            target = decoded;  // 定位落在目标之后时如实标记实际解出的帧
+        } else {
+            next = frames;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (seek_pending) {
+            continue;  // 解码期间有了新的定位请求，这一帧作废
+        }
+        if (!ok) {
+            produce = frames;
+            finished = true;
+            continue;
+        }
+        ring.push_back({image, target, index.pts_ms[target]});
+        ++counters.decoded;
+        if (keyframes_only) {
+            // 按倍速把时钟往前推一个显示间隔，取那里所属的关键帧；GOP 比间隔长时取下一个关键帧
+            const int64_t advance = std::llround(current_speed * 1000.0 / index.fps);
+            const uint32_t key = index.keyframe_of[index.frame_at(index.pts_ms[target] + advance)];
+            produce = key > target ? key : target + 1;
+        } else {
+            produce = target + 1;
+        }
+    }
+}
+
+void PlaybackEngine::request_seek(uint32_t frame, bool show) {
+    seek_pending = true;
+    seek_frame = frame;
+    show_next = show;
+    finished = false;
+    ring.clear();
+    wake.notify_one();
+}
+
+void PlaybackEngine::reanchor() {
+    anchor_wall_ns = monotonic_ns();
+    anchor_pts_ms = shown_pts_ms;
+}
+
+bool PlaybackEngine::is_ready() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return ready;
+}
+
+bool PlaybackEngine::has_failed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failed;
+}
+
+void PlaybackEngine::play() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ready && finished && ring.empty()) {
+        request_seek(0, true);  // 放完了再按播放：从头开始
+    }
+    playing = true;
+    reanchor();
+}
+
+void PlaybackEngine::pause() {
+    std::lock_guard<std::mutex> lock(mutex);
+    playing = false;
+}
+
+bool PlaybackEngine::is_playing() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return playing;
+}
+
+bool PlaybackEngine::needs_refresh() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return playing || show_next || (!ready && !failed);
+}
+
+void PlaybackEngine::set_speed(double speed) {
+    speed = std::max(0.25, std::min(16.0, speed));
+    std::lock_guard<std::mutex> lock(mutex);
+    const bool mode_changed = (speed > kKeyframeOnlySpeed) != (this->speed > kKeyframeOnlySpeed);
+    this->speed = speed;
+    reanchor();
+    if (ready && shown && mode_changed) {
+        // 帧环里是按旧方式挑的帧（全部帧/只有关键帧），从当前位置重新开始
+        request_seek(std::min<uint32_t>(shown_frame + 1, index.frames() - 1), false);
+    }
+}
+
+double PlaybackEngine::get_speed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return speed;
+}
+
+void PlaybackEngine::seek(int64_t ms) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!ready) {
+        start_ms = ms;
+        return;
+    }
+    request_seek(index.frame_at(ms), true);
+}
+
+void PlaybackEngine::step(int frames) {
+    std::lock_guard<std::mutex> lock(mutex);
+    playing = false;
+    if (!ready || frames == 0) {
+        return;
+    }
+    const int64_t last = static_cast<int64_t>(index.frames()) - 1;
+    const int64_t target = std::max<int64_t>(0, std::min<int64_t>(last, static_cast<int64_t>(shown ? shown_frame : 0) + frames));
+    if (!ring.empty() && ring.front().frame == target) {
+        show_next = true;  // 预先解码好了，不用等解码线程
+        return;
+    }
+    request_seek(static_cast<uint32_t>(target), true);
+}
+
+bool PlaybackEngine::poll(cv::Mat& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!ready || ring.empty()) {
+        if (playing && finished && ring.empty()) {
+            playing = false;  // 放完了
+        }
+        return false;
+    }
+    bool taken = false;
+    if (show_next) {
+        show_next = false;
+        out = ring.front().image;
+        shown_frame = ring.front().frame;
+        shown_pts_ms = ring.front().pts_ms;
+        ring.pop_front();
+        reanchor();
+        taken = true;
+    } else if (playing) {
+        const int64_t now_pts = anchor_pts_ms + static_cast<int64_t>((monotonic_ns() - anchor_wall_ns) * speed / 1e6);
+        while (!ring.empty() && ring.front().pts_ms <= now_pts) {
+            if (taken) {
+                ++counters.late;
+            }
+            out = ring.front().image;
+            shown_frame = ring.front().frame;
+            shown_pts_ms = ring.front().pts_ms;
+            ring.pop_front();
+            taken = true;
+        }
+    }
+    if (taken) {
+        shown = true;
+        wake.notify_one();  // 帧环有空位了
+    }
+    return taken;
+}
+
+int64_t PlaybackEngine::position_ms() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return shown_pts_ms;
+}
+
+int64_t PlaybackEngine::duration_ms() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!ready) {
+        return 0;
+    }
+    return index.pts_ms.back() + static_cast<int64_t>(1000.0 / index.fps);
+}
+
+PlaybackStats PlaybackEngine::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    PlaybackStats stats = counters;
+    stats.buffered = ring.size();
+    return stats;
+}
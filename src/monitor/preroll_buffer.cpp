@@ -0,0 +1,84 @@
+#include "preroll_buffer.h"
+
+PrerollBuffer::PrerollBuffer(FrameBus& bus, double seconds, int quality, size_t max_bytes)
+    : bus(bus), seconds(seconds), quality(quality), max_bytes(max_bytes) {
+    SubscriberOptions options;
+    options.queue_depth = 8;  // 压缩偶尔慢一点时的缓冲；跟不上时丢最旧的
+    subscription = bus.subscribe("preroll", options);
+    worker = std::thread(&PrerollBuffer::run, this);
+}
+
+PrerollBuffer::~PrerollBuffer() {
+    stopping = true;
+    subscription->wake();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    bus.unsubscribe(subscription);
+}
+
+void PrerollBuffer::run() {
+    const std::vector<int> params = {cv::IMWRITE_JPEG_QUALITY, quality};
+    while (!stopping) {
+        TimedFrame* slot = subscription->wait_front(std::chrono::milliseconds(100));
+        if (slot == nullptr) {
+            continue;
+        }
+        EncodedFrame encoded;
+        encoded.meta = slot->meta;
+        encoded.generation = slot->generation;
+        const bool ok = !slot->image.empty() && cv::imencode(".jpg", slot->image, encoded.jpeg, params);
+        subscription->pop();
+
+        {
+            std::lock_guard<std::mutex> lock(frames_mutex);
+            handled = encoded.generation;
+            if (ok) {
+                bytes += encoded.jpeg.size();
+                frames.push_back(std::move(encoded));
+                trim();
+            }
+        }
+        handled_cv.notify_all();
+    }
+}
+
+void PrerollBuffer::trim() {
+    // 按采集时间保留最近 seconds 秒，同时不超过内存上限
+    const int64_t newest = frames.back().meta.capture_ns;
+    const int64_t window_ns = static_cast<int64_t>(seconds * 1e9);
+    while (!frames.empty() && (newest - frames.front().meta.capture_ns > window_ns || bytes > max_bytes)) {
+        bytes -= frames.front().jpeg.size();
+        frames.pop_front();
+    }
+}
+
+bool PrerollBuffer::wait_until(uint64_t generation, std::chrono::milliseconds timeout) {
+    // 总线按序号依次发布给所有订阅者：处理到 generation - 1 或更新的帧，之前的帧要么已在缓冲区，要么已被订阅队列丢掉
+    std::unique_lock<std::mutex> lock(frames_mutex);
+    return handled_cv.wait_for(lock, timeout, [&]() { return handled + 1 >= generation; });
+}
+
+std::vector<EncodedFrame> PrerollBuffer::frames_before(uint64_t generation) const {
+    std::lock_guard<std::mutex> lock(frames_mutex);
+    std::vector<EncodedFrame> result;
+    for (const EncodedFrame& frame : frames) {
+        if (frame.generation >= generation) {
+            break;
+        }
+        result.push_back(frame);
+    }
+    return result;
+}
+
+PrerollStats PrerollBuffer::stats() const {
+    PrerollStats stats;
+    stats.skipped = subscription->stats().queue.dropped;
+    std::lock_guard<std::mutex> lock(frames_mutex);
+    stats.frames = frames.size();
+    stats.bytes = bytes;
+    if (!frames.empty()) {
+        stats.seconds = (frames.back().meta.capture_ns - frames.front().meta.capture_ns) / 1e9;
+    }
+    return stats;
+}
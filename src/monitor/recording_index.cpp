@@ -0,0 +1,461 @@
+#include "recording_index.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+#include <regex>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char kMagic[8] = {'M', 'O', 'N', 'I', 'D', 'X', '1', '\0'};
+const size_t kHeaderBytes = 256;
+const size_t kGrowRecords = 1024;  // 文件按块扩展，追加时很少需要重新映射
+const uint8_t kRemoved = 1;
+
+// 文件中的一条记录，定长 256 字节
+struct Record {
+    uint32_t checksum;  // 其余 252 字节的校验和，最后写入；为 0 表示未提交
+    uint32_t camera;
+    int64_t start_ms;
+    int64_t end_ms;
+    uint64_t bytes;
+    uint16_t name_length;
+    uint8_t flags;        // kRemoved：删除标记，指向同一摄像头、同名、更早的记录
+    uint8_t reserved[5];
+    char name[216];
+};
+static_assert(sizeof(Record) == 256, "索引记录必须是 256 字节");
+
+struct Header {
+    char magic[8];
+    uint32_t record_size;
+    uint8_t reserved[kHeaderBytes - 12];
+};
+static_assert(sizeof(Header) == kHeaderBytes, "索引文件头必须是 256 字节");
+
+// FNV-1a，结果避开 0（0 表示未提交）
+uint32_t record_checksum(const Record& record) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&record) + sizeof(record.checksum);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(Record) - sizeof(record.checksum); ++i) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash == 0 ? 1 : hash;
+}
+
+bool fill_record(Record& record, const RecordingEntry& entry, uint8_t flags = 0) {
+    if (entry.filename.size() > sizeof(record.name)) {
+        return false;
+    }
+    std::memset(&record, 0, sizeof(record));
+    record.camera = entry.camera;
+    record.start_ms = entry.start_ms;
+    record.end_ms = entry.end_ms;
+    record.bytes = entry.bytes;
+    record.name_length = static_cast<uint16_t>(entry.filename.size());
+    record.flags = flags;
+    std::memcpy(record.name, entry.filename.data(), entry.filename.size());
+    record.checksum = record_checksum(record);
+    return true;
+}
+
+bool is_recording_file(const fs::path& path) {
+    const std::string ext = path.extension().string();
+    return ext == ".mp4" || ext == ".mkv" || ext == ".avi" || ext == ".mov";
+}
+
+// 从文件名取开始时间：滚动录制的 <prefix>_YYYYmmdd_HHMMSS（本地时间）
+// 或单次录制的 <prefix>_<Unix 秒>；都不是时返回 false
+bool parse_start_ms(const std::string& stem, int64_t& start_ms) {
+    static const std::regex local_stamp("_(\\d{4})(\\d{2})(\\d{2})_(\\d{2})(\\d{2})(\\d{2})");
+    static const std::regex unix_stamp("_(\\d{9,11})(?:_|$)");
+    std::smatch match;
+    if (std::regex_search(stem, match, local_stamp)) {
+        std::tm tm = {};
+        tm.tm_year = std::stoi(match[1]) - 1900;
+        tm.tm_mon = std::stoi(match[2]) - 1;
+        tm.tm_mday = std::stoi(match[3]);
+        tm.tm_hour = std::stoi(match[4]);
+        tm.tm_min = std::stoi(match[5]);
+        tm.tm_sec = std::stoi(match[6]);
+        tm.tm_isdst = -1;
+        const std::time_t t = std::mktime(&tm);
+        if (t == -1) {
+            return false;
+        }
+        start_ms = static_cast<int64_t>(t) * 1000;
+        return true;
+    }
+    if (std::regex_search(stem, match, unix_stamp)) {
+        start_ms = std::stoll(match[1]) * 1000;
+        return true;
+    }
+    return false;
+}
+
+// 读取一个录制文件的信息；文件名里没有时间时打开视频按时长倒推开始时间
+bool scan_file(const fs::path& path, uint32_t camera, RecordingEntry& entry) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    entry.camera = camera;
+    entry.filename = path.string();
+    entry.bytes = static_cast<uint64_t>(st.st_size);
+    entry.end_ms = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000 + st.st_mtim.tv_nsec / 1000000;
+    if (parse_start_ms(path.stem().string(), entry.start_ms)) {
+        return true;
+    }
+    entry.start_ms = entry.end_ms;
+    cv::VideoCapture capture(path.string());
+    if (capture.isOpened()) {
+        const double frames = capture.get(cv::CAP_PROP_FRAME_COUNT);
+        const double fps = capture.get(cv::CAP_PROP_FPS);
+        if (frames > 0 && fps > 0) {
+            entry.start_ms -= static_cast<int64_t>(frames / fps * 1000.0);
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+RecordingIndex::RecordingIndex(const std::string& path) : path(path) {}
+
+RecordingIndex::~RecordingIndex() {
+    unload();
+}
+
+bool RecordingIndex::map_file(size_t records) {
+    if (map != nullptr) {
+        munmap(map, map_bytes);
+        map = nullptr;
+    }
+    map_bytes = kHeaderBytes + records * sizeof(Record);
+    void* mapped = mmap(nullptr, map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "无法映射录制索引：" << path << "，错误：" << strerror(errno) << std::endl;
+        map_bytes = 0;
+        capacity = 0;
+        return false;
+    }
+    map = static_cast<uint8_t*>(mapped);
+    capacity = records;
+    return true;
+}
+
+bool RecordingIndex::committed(size_t record) const {
+    const Record* r = reinterpret_cast<const Record*>(map + kHeaderBytes) + record;
+    return r->checksum != 0 && r->checksum == record_checksum(*r);
+}
+
+RecordingEntry RecordingIndex::read(size_t record) const {
+    const Record* r = reinterpret_cast<const Record*>(map + kHeaderBytes) + record;
+    RecordingEntry entry;
+    entry.camera = r->camera;
+    entry.start_ms = r->start_ms;
+    entry.end_ms = r->end_ms;
+    entry.bytes = r->bytes;
+    entry.filename.assign(r->name, std::min<size_t>(r->name_length, sizeof(r->name)));
+    return entry;
+}
+
+bool RecordingIndex::load() {
+    if (loaded) {
+        return fd >= 0;
+    }
+    loaded = true;
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "无法打开录制索引：" << path << "，错误：" << strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        unload();
+        return false;
+    }
+    if (st.st_size == 0) {
+        // 新文件：写文件头，预留一块记录
+        Header header = {};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.record_size = sizeof(Record);
+        if (pwrite(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+            ftruncate(fd, kHeaderBytes + kGrowRecords * sizeof(Record)) != 0 || fdatasync(fd) != 0) {
+            std::cerr << "无法初始化录制索引：" << path << std::endl;
+            unload();
+            return false;
+        }
+        st.st_size = kHeaderBytes + kGrowRecords * sizeof(Record);
+    }
+    Header header;
+    if (static_cast<size_t>(st.st_size) < kHeaderBytes ||
+        pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.record_size != sizeof(Record)) {
+        std::cerr << "录制索引格式不对，需要重建：" << path << std::endl;
+        unload();
+        return false;
+    }
+    if (!map_file((st.st_size - kHeaderBytes) / sizeof(Record))) {
+        unload();
+        return false;
+    }
+
+    // 有效记录是开头连续的一段：二分查找第一条未提交的记录
+    size_t lo = 0;
+    size_t hi = capacity;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (committed(mid)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    count = lo;
+
+    const Record* records = reinterpret_cast<const Record*>(map + kHeaderBytes);
+    // 删除标记只作用于它之前的同名记录（之后同名文件可以再次登记）
+    std::map<std::pair<uint32_t, std::string>, size_t> removed;
+    for (size_t i = 0; i < count; ++i) {
+        if (records[i].flags & kRemoved) {
+            removed[{records[i].camera, read(i).filename}] = i;
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const Record& r = records[i];
+        if (r.flags & kRemoved) {
+            continue;
+        }
+        if (!removed.empty()) {
+            auto found = removed.find({r.camera, read(i).filename});
+            if (found != removed.end() && found->second > i) {
+                continue;
+            }
+        }
+        CameraSpans& camera = cameras[r.camera];
+        camera.spans.push_back({r.start_ms, r.end_ms, static_cast<uint32_t>(i)});
+        camera.max_length_ms = std::max(camera.max_length_ms, r.end_ms - r.start_ms);
+    }
+    for (auto& camera : cameras) {
+        std::sort(camera.second.spans.begin(), camera.second.spans.end(),
+                  [](const Span& a, const Span& b) { return a.start_ms < b.start_ms; });
+    }
+    return true;
+}
+
+void RecordingIndex::unload() {
+    if (map != nullptr) {
+        munmap(map, map_bytes);
+        map = nullptr;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    map_bytes = 0;
+    capacity = 0;
+    count = 0;
+    cameras.clear();
+    loaded = false;
+}
+
+void RecordingIndex::add_span(uint32_t camera, int64_t start_ms, int64_t end_ms, uint32_t record) {
+    CameraSpans& spans = cameras[camera];
+    const Span span = {start_ms, end_ms, record};
+    // 录制大多按时间顺序结束，插入点通常就在末尾
+    auto it = std::upper_bound(spans.spans.begin(), spans.spans.end(), span,
+                               [](const Span& a, const Span& b) { return a.start_ms < b.start_ms; });
+    spans.spans.insert(it, span);
+    spans.max_length_ms = std::max(spans.max_length_ms, end_ms - start_ms);
+}
+
+bool RecordingIndex::append_locked(const RecordingEntry& entry) {
+    Record record;
+    if (!fill_record(record, entry)) {
+        std::cerr << "文件名过长，未加入录制索引：" << entry.filename << std::endl;
+        return false;
+    }
+    if (!load() || !write_record(&record)) {
+        return false;
+    }
+    add_span(entry.camera, entry.start_ms, entry.end_ms, static_cast<uint32_t>(count - 1));
+    return true;
+}
+
+bool RecordingIndex::write_record(const void* data) {
+    const Record& record = *static_cast<const Record*>(data);
+    if (count == capacity) {
+        const size_t grown = capacity + kGrowRecords;
+        // 新长度先落盘，否则断电后文件截短回去，后面同步过的记录也跟着丢掉
+        if (ftruncate(fd, kHeaderBytes + grown * sizeof(Record)) != 0 || fdatasync(fd) != 0 || !map_file(grown)) {
+            std::cerr << "无法扩展录制索引：" << path << std::endl;
+            unload();
+            return false;
+        }
+    }
+    // 先写内容，最后写校验和：崩溃时要么整条有效，要么被当作未提交
+    Record* slot = reinterpret_cast<Record*>(map + kHeaderBytes) + count;
+    std::memcpy(reinterpret_cast<uint8_t*>(slot) + sizeof(record.checksum),
+                reinterpret_cast<const uint8_t*>(&record) + sizeof(record.checksum),
+                sizeof(Record) - sizeof(record.checksum));
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->checksum = record.checksum;
+    // 等这一页写回磁盘再返回：MS_ASYNC 只防进程崩溃，断电时还在页缓存里的记录会丢。
+    // 每个录制文件或分段只追加一条，同步写的开销可以忽略
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t offset = reinterpret_cast<uint8_t*>(slot) - map;
+    if (msync(map + offset / page * page, offset % page + sizeof(Record), MS_SYNC) != 0) {
+        std::cerr << "录制索引未能写回磁盘：" << path << std::endl;  // 记录仍在页缓存里，进程内照常可见
+    }
+    ++count;
+    return true;
+}
+
+bool RecordingIndex::append(const RecordingEntry& entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return append_locked(entry);
+}
+
+bool RecordingIndex::remove(uint32_t camera, const std::string& filename) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!load()) {
+        return false;
+    }
+    auto found = cameras.find(camera);
+    auto matches = [&](const Span& span) { return read(span.record).filename == filename; };
+    if (found == cameras.end() || std::none_of(found->second.spans.begin(), found->second.spans.end(), matches)) {
+        return false;
+    }
+    // 记录文件只追加：写一条删除标记，重新打开时据此跳过原记录
+    RecordingEntry marker;
+    marker.camera = camera;
+    marker.filename = filename;
+    Record record;
+    if (!fill_record(record, marker, kRemoved) || !write_record(&record)) {
+        return false;
+    }
+    std::vector<Span>& spans = cameras[camera].spans;  // 扩展文件可能重新映射过，重新取
+    spans.erase(std::remove_if(spans.begin(), spans.end(), matches), spans.end());
+    return true;
+}
+
+std::vector<RecordingEntry> RecordingIndex::query(uint32_t camera, int64_t from_ms, int64_t to_ms) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<RecordingEntry> result;
+    if (!load()) {
+        return result;
+    }
+    auto found = cameras.find(camera);
+    if (found == cameras.end()) {
+        return result;
+    }
+    // 开始时间早于 from - 最长时长的记录不可能覆盖 from，从那里开始找
+    const std::vector<Span>& spans = found->second.spans;
+    const int64_t earliest = from_ms > INT64_MIN + found->second.max_length_ms ? from_ms - found->second.max_length_ms
+                                                                              : INT64_MIN;
+    auto it = std::lower_bound(spans.begin(), spans.end(), earliest,
+                               [](const Span& span, int64_t start) { return span.start_ms < start; });
+    for (; it != spans.end() && it->start_ms <= to_ms; ++it) {
+        if (it->end_ms >= from_ms) {
+            result.push_back(read(it->record));
+        }
+    }
+    return result;
+}
+
+size_t RecordingIndex::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    load();
+    size_t live = 0;
+    for (const auto& camera : cameras) {
+        live += camera.second.spans.size();
+    }
+    return live;
+}
+
+long RecordingIndex::rebuild(const std::string& directory, uint32_t camera) {
+    std::vector<fs::path> files;
+    std::error_code ec;
+    for (fs::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->is_regular_file(ec) && is_recording_file(it->path())) {
+            files.push_back(it->path());
+        }
+    }
+    if (ec) {
+        std::cerr << "无法读取录制目录：" << directory << std::endl;
+        return -1;
+    }
+
+    // 逐个文件 stat，个别文件还要打开读时长：并行进行
+    std::vector<RecordingEntry> scanned(files.size());
+    std::vector<char> ok(files.size(), 0);
+    cv::parallel_for_(cv::Range(0, static_cast<int>(files.size())), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; ++i) {
+            ok[i] = scan_file(files[i], camera, scanned[i]);
+        }
+    });
+
+    std::lock_guard<std::mutex> lock(mutex);
+    load();
+    // 其他摄像头只保留仍有效的记录，删除标记不再需要
+    std::vector<RecordingEntry> entries;
+    for (const auto& other : cameras) {
+        if (other.first != camera) {
+            for (const Span& span : other.second.spans) {
+                entries.push_back(read(span.record));
+            }
+        }
+    }
+    long found = 0;
+    for (size_t i = 0; i < scanned.size(); ++i) {
+        if (ok[i]) {
+            entries.push_back(std::move(scanned[i]));
+            ++found;
+        }
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const RecordingEntry& a, const RecordingEntry& b) { return a.start_ms < b.start_ms; });
+
+    // 写到临时文件，fsync 后改名替换：任何时刻磁盘上都是一个完整的索引
+    const std::string temp = path + ".tmp";
+    std::vector<uint8_t> buffer(kHeaderBytes + (entries.size() + kGrowRecords) * sizeof(Record), 0);
+    Header* header = reinterpret_cast<Header*>(buffer.data());
+    std::memcpy(header->magic, kMagic, sizeof(kMagic));
+    header->record_size = sizeof(Record);
+    Record* records = reinterpret_cast<Record*>(buffer.data() + kHeaderBytes);
+    size_t written = 0;
+    for (const RecordingEntry& entry : entries) {
+        written += fill_record(records[written], entry);
+    }
+    const int out = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool saved = out >= 0;
+    for (size_t done = 0; saved && done < buffer.size();) {
+        const ssize_t n = ::write(out, buffer.data() + done, buffer.size() - done);
+        saved = n > 0;
+        done += saved ? n : 0;
+    }
+    saved = saved && fsync(out) == 0;
+    if (out >= 0) {
+        ::close(out);
+    }
+    if (!saved || std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::cerr << "无法写入录制索引：" << path << std::endl;
+        std::remove(temp.c_str());
+        return -1;
+    }
+    unload();
+    load();
+    std::cout << "录制索引已重建：摄像头 " << camera << "，" << found << " 个文件" << std::endl;
+    return found;
+}
@@ -0,0 +1,74 @@
+#include "replay_source.h"
+
+ReplaySource::ReplaySource(const std::string& filename, bool max_speed, bool loop,
+                           unsigned int buffer_count)
+    : filename(filename),
+      capture(filename),
+      max_speed(max_speed),
+      loop(loop),
+      fps(capture.get(cv::CAP_PROP_FPS)),
+      frame_width(static_cast<int>(capture.get(cv::CAP_PROP_FRAME_WIDTH))),
+      frame_height(static_cast<int>(capture.get(cv::CAP_PROP_FRAME_HEIGHT))),
+      pool(buffer_count, frame_height, frame_width, CV_8UC3),
+      next_frame_time(std::chrono::steady_clock::now())
+{
+    if (!capture.isOpened()) {
+        std::cerr << "无法打开回放文件: " << filename << std::endl;
+        return;
+    }
+    if (fps <= 0) {
+        fps = 30.0;
+    }
+    std::cout << "Init replay source: " << filename << " (" << frame_width << "x" << frame_height
+              << "@" << fps << (max_speed ? ", max speed" : "") << ")" << std::endl;
+}
+
+bool ReplaySource::acquire_frame(FrameLease& lease, int timeout_ms) {
+    if (!capture.isOpened()) {
+        return false;
+    }
+    if (!max_speed) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        if (next_frame_time > deadline) {
+            sleep_until(deadline);
+            return false;
+        }
+        if (!sleep_until(next_frame_time)) {
+            return false;  // 被 wake() 打断
+        }
+        auto now = std::chrono::steady_clock::now();
+        next_frame_time += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / fps));
+        if (next_frame_time < now) {
+            next_frame_time = now;
+        }
+    }
+
+    unsigned int index;
+    if (!pool.take(index)) {
+        return false;
+    }
+    // 解码直接写入池中的槽位，尺寸一致时不会重新分配
+    cv::Mat& slot = pool.slot(index);
+    bool ok = capture.read(slot);
+    if (!ok && loop) {
+        capture.set(cv::CAP_PROP_POS_FRAMES, 0);
+        ok = capture.read(slot);
+    }
+    if (!ok || slot.empty()) {
+        // 归还槽位：包装成租约后立即释放
+        pool.lease(index, V4L2_PIX_FMT_BGR24, 0);
+        return false;
+    }
+    // 回放没有驱动时间戳，以解码完成时刻作为采集时间，文件中的帧号作为序号
+    FrameMeta meta;
+    meta.sequence = static_cast<uint64_t>(capture.get(cv::CAP_PROP_POS_FRAMES));
+    meta.capture_ns = monotonic_ns();
+    meta.dequeue_ns = meta.capture_ns;
+    lease = pool.lease(index, V4L2_PIX_FMT_BGR24, slot.total() * slot.elemSize(), 0, 0, meta);
+    return true;
+}
+
+void ReplaySource::initFrame(cv::Mat& frame) {
+    frame = cv::Mat(frame_height, frame_width, CV_8UC3, cv::Scalar(0, 0, 0));
+}
@@ -0,0 +1,223 @@
+#include "rolling_recorder.h"
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+RollingRecorder::RollingRecorder(int codec, double fps, const RollingOptions& options,
+                                 std::function<void(const SegmentInfo&)> on_closed,
+                                 std::function<void(const std::string&)> on_deleted)
+    : codec(codec), fps(fps), options(options), on_closed(std::move(on_closed)), on_deleted(std::move(on_deleted)) {
+    if (this->options.segment_seconds <= 0) {
+        this->options.segment_seconds = 60;
+    }
+    std::error_code ec;
+    fs::create_directories(this->options.directory, ec);
+    closer = std::thread(&RollingRecorder::closer_loop, this);
+}
+
+RollingRecorder::~RollingRecorder() {
+    finish();
+}
+
+bool RollingRecorder::open_segment(const cv::Size& size) {
+    // 以开始时间命名，同一秒内重复时加序号
+    const auto now = std::chrono::system_clock::now();
+    const std::time_t t = std::chrono::system_clock::to_time_t(now);
+    std::tm tm;
+    localtime_r(&t, &tm);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &tm);
+    const std::string base = options.prefix + "_" + stamp;
+    std::string name = base + options.extension;
+    for (int n = 1; fs::exists(fs::path(options.directory) / name); ++n) {
+        name = base + "_" + std::to_string(n) + options.extension;
+    }
+    const std::string path = (fs::path(options.directory) / name).string();
+
+    std::unique_ptr<VideoSink> next = open_video_sink(path, codec, fps, size, options.nv12);
+    if (!next) {
+        std::cerr << "无法创建视频文件：" << path << std::endl;
+        return false;
+    }
+    writer = std::move(next);
+    current = SegmentInfo();
+    current.filename = path;
+    current.start_time = now;
+    {
+        std::lock_guard<std::mutex> lock(closing_mutex);
+        open_path = name;
+    }
+    std::cout << "开始录制分段：" << path << std::endl;
+    return true;
+}
+
+void RollingRecorder::close_segment(std::unique_ptr<VideoSink> segment, const SegmentInfo& info) {
+    if (!segment) {
+        return;
+    }
+    Closing job;
+    job.writer = std::move(segment);
+    job.info = info;
+    job.info.end_time = std::chrono::system_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(closing_mutex);
+        closing.push_back(std::move(job));
+    }
+    closing_cv.notify_one();
+}
+
+bool RollingRecorder::write(const cv::Mat& frame, int64_t capture_ns) {
+    if (frame.empty()) {
+        return false;
+    }
+    if (capture_ns == 0) {
+        capture_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    const bool rollover = writer && capture_ns - segment_start_ns >= static_cast<int64_t>(options.segment_seconds) * 1000000000;
+    if (!writer || rollover) {
+        // 先打开新文件再交出旧文件：这一帧写进新分段，两段之间不丢帧
+        std::unique_ptr<VideoSink> previous = std::move(writer);
+        const SegmentInfo previous_info = current;
+        const bool opened = open_segment(video_frame_size(frame, options.nv12));
+        close_segment(std::move(previous), previous_info);  // 旧文件的收尾（写文件尾等）交给后台线程
+        if (!opened) {
+            return false;
+        }
+        segment_start_ns = capture_ns;
+    }
+    writer->write(frame);
+    ++current.frames;
+    return true;
+}
+
+void RollingRecorder::finish() {
+    close_segment(std::move(writer), current);
+    {
+        std::lock_guard<std::mutex> lock(closing_mutex);
+        stopping = true;
+        open_path.clear();
+    }
+    closing_cv.notify_all();
+    if (closer.joinable()) {
+        closer.join();
+    }
+}
+
+void RollingRecorder::closer_loop() {
+    enforce_retention();  // 先清理上次运行留下的过期分段
+    while (true) {
+        Closing job;
+        bool more_queued;
+        {
+            std::unique_lock<std::mutex> lock(closing_mutex);
+            closing_cv.wait(lock, [&]() { return stopping || !closing.empty(); });
+            if (closing.empty()) {
+                return;
+            }
+            job = std::move(closing.front());
+            closing.pop_front();
+            more_queued = !closing.empty();
+        }
+        const bool complete = job.writer->release();
+        ++closed_count;
+        if (!complete) {
+            std::cerr << "分段未能完整写出，未登记：" << job.info.filename << std::endl;
+        } else {
+            std::cout << "分段录制完成：" << job.info.filename << "（" << job.info.frames << " 帧）" << std::endl;
+            if (on_closed) {
+                on_closed(job.info);
+            }
+        }
+        // 还有分段排队等收尾时先不清理，免得删到尚未关闭的文件
+        if (!more_queued) {
+            enforce_retention();
+        }
+    }
+}
+
+bool RollingRecorder::is_segment_name(const std::string& name) const {
+    // <prefix>_YYYYmmdd_HHMMSS[_n]<extension>：同一目录里手动录制的 <prefix>_<Unix 秒> 等文件不会被当成分段
+    const std::string head = options.prefix + "_";
+    if (name.size() < head.size() + 15 + options.extension.size() || name.compare(0, head.size(), head) != 0 ||
+        name.compare(name.size() - options.extension.size(), options.extension.size(), options.extension) != 0) {
+        return false;
+    }
+    const std::string stamp = name.substr(head.size(), name.size() - head.size() - options.extension.size());
+    if (stamp.size() != 15 && (stamp.size() < 17 || stamp[15] != '_')) {
+        return false;  // 只有时间，或时间后跟 _<序号>
+    }
+    for (size_t i = 0; i < stamp.size(); ++i) {
+        const bool separator = i == 8 || i == 15;
+        if (separator ? stamp[i] != '_' : !std::isdigit(static_cast<unsigned char>(stamp[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void RollingRecorder::enforce_retention() {
+    struct Entry {
+        fs::path path;
+        fs::file_time_type mtime;
+        uint64_t size;
+    };
+    std::string skip;
+    {
+        std::lock_guard<std::mutex> lock(closing_mutex);
+        skip = open_path;
+    }
+
+    // 按分段的命名规则识别分段文件，包括以前运行留下的
+    std::vector<Entry> entries;
+    std::error_code ec;
+    for (fs::directory_iterator it(options.directory, ec), end; !ec && it != end; it.increment(ec)) {
+        const std::string name = it->path().filename().string();
+        if (!it->is_regular_file(ec) || name == skip || !is_segment_name(name)) {
+            continue;
+        }
+        Entry entry{it->path(), it->last_write_time(ec), static_cast<uint64_t>(it->file_size(ec))};
+        if (!ec) {
+            entries.push_back(entry);
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.mtime < b.mtime; });
+
+    uint64_t total = 0;
+    for (const Entry& entry : entries) {
+        total += entry.size;
+    }
+    const auto now = fs::file_time_type::clock::now();
+    const auto max_age = std::chrono::minutes(options.max_age_minutes);
+    // 从最旧的开始删，直到既不过期也不超预算（之后的文件更新，总量也只会更小）
+    for (const Entry& entry : entries) {
+        const bool expired = options.max_age_minutes > 0 && now - entry.mtime > max_age;
+        const bool over_budget = options.max_total_bytes > 0 && total > options.max_total_bytes;
+        if (!expired && !over_budget) {
+            break;
+        }
+        if (fs::remove(entry.path, ec)) {
+            total -= entry.size;
+            ++deleted_count;
+            std::cout << "删除过期分段：" << entry.path.string() << std::endl;
+            if (on_deleted) {
+                on_deleted(entry.path.string());
+            }
+        }
+    }
+    retained_bytes = total;
+}
+
+RollingStats RollingRecorder::stats() const {
+    RollingStats stats;
+    stats.segments_closed = closed_count.load();
+    stats.segments_deleted = deleted_count.load();
+    stats.bytes_retained = retained_bytes.load();
+    return stats;
+}
@@ -0,0 +1,282 @@
+#include "segmented_encoder.h"
+#include "video_sink.h"
+#include <spawn.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+extern char** environ;
+
+namespace {
+
+const size_t kBytesPerWorker = 128 * 1024 * 1024;  // max_pending_bytes 为 0 时每个线程分到的帧内存
+
+}  // namespace
+
+SegmentedEncoder::SegmentedEncoder(const std::string& output, int codec, double fps,
+                                   const SegmentedEncoderOptions& options)
+    : output(output), codec(codec), fps(fps), options(options) {
+    int worker_count = options.workers;
+    if (worker_count <= 0) {
+        worker_count = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+    }
+    if (this->options.segment_frames <= 0) {
+        this->options.segment_frames = 60;
+    }
+    if (this->options.max_pending <= 0) {
+        this->options.max_pending = worker_count * 2;
+    }
+    if (this->options.max_pending_bytes == 0) {
+        this->options.max_pending_bytes = kBytesPerWorker * (worker_count + 1);
+    }
+    this->options.min_segment_frames = std::max(1, std::min(this->options.min_segment_frames, this->options.segment_frames));
+    for (int i = 0; i < worker_count; ++i) {
+        workers.emplace_back(&SegmentedEncoder::worker_loop, this);
+    }
+}
+
+SegmentedEncoder::~SegmentedEncoder() {
+    finish();
+}
+
+std::string SegmentedEncoder::segment_path(size_t index) const {
+    // recording.mp4 -> recording.part0003.mp4，扩展名决定容器
+    const size_t dot = output.find_last_of('.');
+    const size_t slash = output.find_last_of('/');
+    const bool has_ext = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+    char part[16];
+    std::snprintf(part, sizeof(part), ".part%04zu", index);
+    return has_ext ? output.substr(0, dot) + part + output.substr(dot) : output + part;
+}
+
+int SegmentedEncoder::segment_length_for(size_t frame_bytes) const {
+    const size_t fit = options.max_pending_bytes / ((workers.size() + 1) * std::max<size_t>(frame_bytes, 1));
+    const size_t length = std::max<size_t>(fit, options.min_segment_frames);
+    return static_cast<int>(std::min<size_t>(length, options.segment_frames));
+}
+
+bool SegmentedEncoder::fits_locked(size_t bytes) const {
+    return options.max_pending_bytes == 0 ||
+           pending_bytes + held_bytes + spare_bytes + bytes <= options.max_pending_bytes;
+}
+
+cv::Mat SegmentedEncoder::acquire_buffer(std::unique_lock<std::mutex>& lock, const cv::Mat& frame, size_t bytes) {
+    cv::Mat buffer;
+    while (true) {
+        if (!spare.empty()) {
+            if (spare.back().size() == frame.size() && spare.back().type() == frame.type()) {
+                // 复用编码完的缓冲区：内存总量不变
+                buffer = std::move(spare.back());
+                spare.pop_back();
+                spare_bytes -= bytes;
+                break;
+            }
+            spare.clear();  // 分辨率变了，旧缓冲区没用了
+            spare_bytes = 0;
+            continue;
+        }
+        if (fits_locked(bytes)) {
+            break;
+        }
+        if (pending > 0) {
+            // 编码跟不上：等一段写完，压力传回录制队列，由它的背压策略处理
+            ++wait_count;
+            done_cv.wait(lock);
+        } else if (current && !current->frames.empty()) {
+            submit_locked(lock);  // 没有在途段可等：当前段提前交出
+        } else {
+            break;  // 单帧就超过上限，只能放行
+        }
+    }
+    held_bytes += bytes;
+    peak_bytes = std::max(peak_bytes, pending_bytes + held_bytes + spare_bytes);
+    return buffer;
+}
+
+void SegmentedEncoder::write(const cv::Mat& frame) {
+    if (finished || frame.empty()) {
+        return;
+    }
+    const size_t bytes = frame.total() * frame.elemSize();
+    cv::Mat buffer;
+    {
+        std::unique_lock<std::mutex> lock(jobs_mutex);
+        buffer = acquire_buffer(lock, frame, bytes);
+    }
+    // 拷贝而不是引用：采集端的槽位缓冲区可以原地复用
+    frame.copyTo(buffer);
+    if (bytes != segment_frame_bytes) {
+        segment_frame_bytes = bytes;
+        segment_length = segment_length_for(bytes);
+    }
+    if (!current) {
+        current = std::make_shared<Segment>();
+        current->index = segments.size();
+        current->path = segment_path(current->index);
+        current->frames.reserve(segment_length);
+    }
+    current->frames.push_back(std::move(buffer));
+    current->bytes += bytes;
+    ++frame_count;
+    if (static_cast<int>(current->frames.size()) >= segment_length) {
+        submit_current();
+    }
+}
+
+void SegmentedEncoder::submit_current() {
+    std::unique_lock<std::mutex> lock(jobs_mutex);
+    submit_locked(lock);
+}
+
+void SegmentedEncoder::submit_locked(std::unique_lock<std::mutex>& lock) {
+    if (!current) {
+        return;
+    }
+    // 编码跟不上时在这里等，压力传回录制队列，由它的背压策略处理，内存不会无限增长
+    if (pending >= static_cast<size_t>(options.max_pending)) {
+        ++wait_count;
+        done_cv.wait(lock, [&]() { return pending < static_cast<size_t>(options.max_pending); });
+    }
+    segments.push_back(current);
+    jobs.push_back(current);
+    ++pending;
+    pending_bytes += current->bytes;
+    held_bytes -= current->bytes;
+    current.reset();
+    jobs_cv.notify_one();
+}
+
+bool SegmentedEncoder::encode_segment(Segment& segment, int codec, double fps, bool nv12) {
+    std::unique_ptr<VideoSink> writer =
+        open_video_sink(segment.path, codec, fps, video_frame_size(segment.frames.front(), nv12), nv12);
+    if (!writer) {
+        std::cerr << "无法创建视频分段：" << segment.path << std::endl;
+        return false;
+    }
+    bool ok = true;
+    for (const cv::Mat& frame : segment.frames) {
+        ok = writer->write(frame) && ok;
+    }
+    return writer->release() && ok;
+}
+
+void SegmentedEncoder::worker_loop() {
+    while (true) {
+        std::shared_ptr<Segment> segment;
+        {
+            std::unique_lock<std::mutex> lock(jobs_mutex);
+            jobs_cv.wait(lock, [&]() { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;  // stopping 且没有剩余任务
+            }
+            segment = jobs.front();
+            jobs.pop_front();
+        }
+        segment->ok = encode_segment(*segment, codec, fps, options.nv12);
+        ++(segment->ok ? encoded_count : failed_count);
+        {
+            // 帧缓冲区留给录制线程复用，仍计入内存上限
+            std::lock_guard<std::mutex> lock(jobs_mutex);
+            --pending;
+            pending_bytes -= segment->bytes;
+            for (cv::Mat& frame : segment->frames) {
+                spare_bytes += frame.total() * frame.elemSize();
+                spare.push_back(std::move(frame));
+            }
+        }
+        segment->frames.clear();
+        segment->frames.shrink_to_fit();
+        done_cv.notify_all();
+    }
+}
+
+bool SegmentedEncoder::finish() {
+    if (finished) {
+        return false;
+    }
+    submit_current();
+    {
+        std::unique_lock<std::mutex> lock(jobs_mutex);
+        done_cv.wait(lock, [&]() { return pending == 0; });
+        stopping = true;
+    }
+    jobs_cv.notify_all();
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    finished = true;
+    spare.clear();
+    spare_bytes = 0;
+    if (segments.empty()) {
+        return false;
+    }
+    for (const auto& segment : segments) {
+        if (!segment->ok) {
+            std::cerr << "部分分段编码失败，保留分段文件未拼接：" << output << std::endl;
+            return false;
+        }
+    }
+    return concatenate();
+}
+
+bool SegmentedEncoder::concatenate() {
+    if (segments.size() == 1) {
+        // 只有一段：直接改名即可
+        return std::rename(segments.front()->path.c_str(), output.c_str()) == 0;
+    }
+
+    // ffconcat 播放列表，路径相对于列表文件所在目录
+    const std::string list_path = output + ".ffconcat";
+    {
+        std::ofstream list(list_path);
+        list << "ffconcat version 1.0\n";
+        for (const auto& segment : segments) {
+            const size_t slash = segment->path.find_last_of('/');
+            list << "file '" << (slash == std::string::npos ? segment->path : segment->path.substr(slash + 1)) << "'\n";
+        }
+        if (!list) {
+            std::cerr << "无法写入分段列表：" << list_path << std::endl;
+            return false;
+        }
+    }
+
+    // 流拷贝拼接：各段都以关键帧开头，参数一致，不需要重新编码
+    const char* argv[] = {"ffmpeg", "-y", "-loglevel", "error", "-f", "concat", "-safe", "0",
+                          "-i", list_path.c_str(), "-c", "copy", output.c_str(), nullptr};
+    pid_t pid;
+    int status = 0;
+    const bool spawned = posix_spawnp(&pid, "ffmpeg", nullptr, nullptr, const_cast<char* const*>(argv), environ) == 0;
+    if (!spawned || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cerr << "无法拼接分段（需要 ffmpeg），分段和播放列表保留在：" << list_path << std::endl;
+        if (spawned) {
+            std::remove(output.c_str());  // ffmpeg 出错时可能留下写了一半的文件
+        }
+        return false;
+    }
+
+    if (!options.keep_segments) {
+        for (const auto& segment : segments) {
+            std::remove(segment->path.c_str());
+        }
+        std::remove(list_path.c_str());
+    }
+    return true;
+}
+
+SegmentedEncoderStats SegmentedEncoder::stats() {
+    SegmentedEncoderStats stats;
+    stats.frames = frame_count.load();
+    stats.segments_encoded = encoded_count.load();
+    stats.segments_failed = failed_count.load();
+    stats.producer_waits = wait_count.load();
+    std::lock_guard<std::mutex> lock(jobs_mutex);
+    stats.pending = pending;
+    stats.bytes_in_flight = pending_bytes + held_bytes + spare_bytes;
+    stats.peak_bytes = peak_bytes;
+    stats.segment_frames = segment_length;
+    return stats;
+}
@@ -0,0 +1,149 @@
+#include "synthetic_source.h"
+
+SyntheticSource::SyntheticSource(int width, int height, double fps, uint32_t format,
+                                 double jitter_ms, unsigned int buffer_count)
+    : frame_width(width),
+      frame_height(height),
+      format(format),
+      fps(fps > 0 ? fps : 30.0),
+      jitter_ms(jitter_ms),
+      frame_counter(0),
+      dropped(0),
+      pending_drops(0),
+      // MJPEG 槽位是一段足够容纳压缩帧的字节，NV12 槽位是 Y 平面加紧随其后的半高 UV 平面
+      pool(buffer_count, format == V4L2_PIX_FMT_MJPEG ? 1 : (format == V4L2_PIX_FMT_NV12 ? height * 3 / 2 : height),
+           format == V4L2_PIX_FMT_MJPEG ? width * height * 3 : width,
+           format == V4L2_PIX_FMT_YUYV ? CV_8UC2 : (format == V4L2_PIX_FMT_BGR24 ? CV_8UC3 : CV_8UC1)),
+      rng(12345),
+      next_frame_time(std::chrono::steady_clock::now())
+{
+    std::cout << "Init synthetic source: " << width << "x" << height << "@" << this->fps << std::endl;
+    // 背景：水平亮度渐变 + 垂直色度渐变
+    if (format == V4L2_PIX_FMT_NV12) {
+        pattern.create(height * 3 / 2, width, CV_8UC1);
+        for (int y = 0; y < height; ++y) {
+            uint8_t* luma_row = pattern.ptr<uint8_t>(y);
+            for (int x = 0; x < width; ++x) {
+                luma_row[x] = static_cast<uint8_t>(16 + x * 219 / std::max(width - 1, 1));
+            }
+        }
+        for (int y = 0; y < height / 2; ++y) {
+            uint8_t* uv_row = pattern.ptr<uint8_t>(height + y);
+            uint8_t chroma = static_cast<uint8_t>(y * 2 * 255 / std::max(height - 1, 1));
+            for (int x = 0; x < width; x += 2) {
+                uv_row[x] = chroma;
+                uv_row[x + 1] = static_cast<uint8_t>(255 - chroma);
+            }
+        }
+        return;
+    }
+    pattern.create(height, width, format == V4L2_PIX_FMT_YUYV ? CV_8UC2 : CV_8UC3);
+    for (int y = 0; y < height; ++y) {
+        uint8_t* row = pattern.ptr<uint8_t>(y);
+        for (int x = 0; x < width; ++x) {
+            uint8_t luma = static_cast<uint8_t>(16 + x * 219 / std::max(width - 1, 1));
+            uint8_t chroma = static_cast<uint8_t>(y * 255 / std::max(height - 1, 1));
+            if (format == V4L2_PIX_FMT_YUYV) {
+                // YUYV: 每两个像素共享一组 U/V
+                row[x * 2] = luma;
+                row[x * 2 + 1] = (x & 1) ? static_cast<uint8_t>(255 - chroma) : chroma;
+            } else {
+                row[x * 3] = chroma;
+                row[x * 3 + 1] = luma;
+                row[x * 3 + 2] = static_cast<uint8_t>(255 - chroma);
+            }
+        }
+    }
+}
+
+// 背景上叠加一条随帧号移动的竖条，保证相邻帧内容不同
+void SyntheticSource::render(cv::Mat& slot) {
+    cv::Mat& dst = format == V4L2_PIX_FMT_MJPEG ? canvas : slot;
+    pattern.copyTo(dst);
+    const int bar_width = std::max(frame_width / 32, 2) & ~1;
+    const int bar_x = static_cast<int>((frame_counter * 4) % static_cast<uint64_t>(std::max(frame_width - bar_width, 1))) & ~1;
+    const size_t pixel_bytes = dst.elemSize();
+    if (format == V4L2_PIX_FMT_NV12) {
+        for (int y = 0; y < frame_height; ++y) {
+            memset(dst.ptr<uint8_t>(y) + bar_x, 235, bar_width);
+        }
+        for (int y = 0; y < frame_height / 2; ++y) {
+            memset(dst.ptr<uint8_t>(frame_height + y) + bar_x, 128, bar_width);
+        }
+        return;
+    }
+    for (int y = 0; y < frame_height; ++y) {
+        uint8_t* row = dst.ptr<uint8_t>(y) + bar_x * pixel_bytes;
+        if (format == V4L2_PIX_FMT_YUYV) {
+            for (int x = 0; x < bar_width; ++x) {
+                row[x * 2] = 235;
+                row[x * 2 + 1] = 128;
+            }
+        } else {
+            memset(row, 255, bar_width * pixel_bytes);
+        }
+    }
+    if (format == V4L2_PIX_FMT_MJPEG) {
+        cv::imencode(".jpg", canvas, encoded);
+        memcpy(slot.data, encoded.data(), std::min(encoded.size(), slot.total()));
+    }
+}
+
+bool SyntheticSource::acquire_frame(FrameLease& lease, int timeout_ms) {
+    // 按帧率（加随机抖动）节拍输出
+    auto interval = std::chrono::duration<double>(1.0 / fps);
+    double jitter = 0.0;
+    if (jitter_ms > 0) {
+        std::uniform_real_distribution<double> dist(-jitter_ms, jitter_ms);
+        jitter = dist(rng) / 1000.0;
+    }
+    auto due = next_frame_time + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                     std::chrono::duration<double>(std::max(0.0, jitter)));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    if (due > deadline) {
+        sleep_until(deadline);
+        return false;
+    }
+    if (!sleep_until(due)) {
+        return false;  // 被 wake() 打断
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    next_frame_time += std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval);
+    if (next_frame_time < now) {
+        // 消费者太慢，跳过错过的节拍，与真实摄像头行为一致
+        next_frame_time = now;
+    }
+
+    unsigned int index;
+    if (!pool.take(index)) {
+        // 所有缓冲区都被借出，相当于驱动丢帧：序号照样前进，留下缺口
+        ++frame_counter;
+        ++dropped;
+        ++pending_drops;
+        return false;
+    }
+    FrameMeta meta;
+    meta.sequence = frame_counter;
+    meta.capture_ns = monotonic_ns();
+    meta.dropped_before = pending_drops;
+    pending_drops = 0;
+    cv::Mat& slot = pool.slot(index);
+    render(slot);
+    ++frame_counter;
+    size_t bytesused = format == V4L2_PIX_FMT_MJPEG ? std::min(encoded.size(), slot.total())
+                                                    : slot.total() * slot.elemSize();
+    meta.dequeue_ns = monotonic_ns();
+    lease = pool.lease(index, format, bytesused, frame_width, frame_height, meta);
+    return true;
+}
+
+void SyntheticSource::initFrame(cv::Mat& frame) {
+    if (format == V4L2_PIX_FMT_YUYV) {
+        cv::cvtColor(pattern, frame, cv::COLOR_YUV2BGR_YUYV);
+    } else if (format == V4L2_PIX_FMT_NV12) {
+        cv::cvtColor(pattern, frame, cv::COLOR_YUV2BGR_NV12);
+    } else {
+        frame = pattern.clone();
+    }
+}
@@ -0,0 +1,282 @@
+#include "texture_uploader.h"
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+
+// GL 1.1 之后的缓冲区/同步函数，运行时从驱动取得，没有时降级
+struct GlBufferApi {
+    PFNGLGENBUFFERSPROC GenBuffers = nullptr;
+    PFNGLDELETEBUFFERSPROC DeleteBuffers = nullptr;
+    PFNGLBINDBUFFERPROC BindBuffer = nullptr;
+    PFNGLBUFFERDATAPROC BufferData = nullptr;
+    PFNGLBUFFERSTORAGEPROC BufferStorage = nullptr;
+    PFNGLMAPBUFFERRANGEPROC MapBufferRange = nullptr;
+    PFNGLUNMAPBUFFERPROC UnmapBuffer = nullptr;
+    PFNGLFENCESYNCPROC FenceSync = nullptr;
+    PFNGLCLIENTWAITSYNCPROC ClientWaitSync = nullptr;
+    PFNGLDELETESYNCPROC DeleteSync = nullptr;
+    bool loaded = false;
+};
+
+GlBufferApi gl;
+
+template <typename Fn>
+void load_function(Fn& fn, const char* name) {
+    fn = reinterpret_cast<Fn>(glfwGetProcAddress(name));
+}
+
+void load_buffer_api() {
+    if (gl.loaded) {
+        return;
+    }
+    load_function(gl.GenBuffers, "glGenBuffers");
+    load_function(gl.DeleteBuffers, "glDeleteBuffers");
+    load_function(gl.BindBuffer, "glBindBuffer");
+    load_function(gl.BufferData, "glBufferData");
+    load_function(gl.BufferStorage, "glBufferStorage");
+    load_function(gl.MapBufferRange, "glMapBufferRange");
+    load_function(gl.UnmapBuffer, "glUnmapBuffer");
+    load_function(gl.FenceSync, "glFenceSync");
+    load_function(gl.ClientWaitSync, "glClientWaitSync");
+    load_function(gl.DeleteSync, "glDeleteSync");
+    gl.loaded = true;
+}
+
+// GLX 下 glfwGetProcAddress 对不支持的函数也可能返回非空，能否使用以版本号和扩展为准
+bool gl_version_at_least(int major, int minor) {
+    const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    int have_major = 0;
+    int have_minor = 0;
+    if (version == nullptr || std::sscanf(version, "%d.%d", &have_major, &have_minor) != 2) {
+        return false;
+    }
+    return have_major > major || (have_major == major && have_minor >= minor);
+}
+
+}  // namespace
+
+const char* upload_path_name(UploadPath path) {
+    switch (path) {
+    case UploadPath::Direct:
+        return "direct";
+    case UploadPath::Pbo:
+        return "pbo";
+    case UploadPath::PersistentPbo:
+        return "persistent-pbo";
+    }
+    return "unknown";
+}
+
+UploadPath TextureUploader::choose_path(UploadPath preferred) const {
+    if (preferred == UploadPath::Direct) {
+        return UploadPath::Direct;
+    }
+    load_buffer_api();
+    const bool has_pbo = gl.GenBuffers && gl.DeleteBuffers && gl.BindBuffer && gl.BufferData &&
+                         gl.MapBufferRange && gl.UnmapBuffer &&
+                         (gl_version_at_least(3, 0) || (glfwExtensionSupported("GL_ARB_pixel_buffer_object") &&
+                                                        glfwExtensionSupported("GL_ARB_map_buffer_range")));
+    if (!has_pbo) {
+        return UploadPath::Direct;
+    }
+    const bool has_persistent = gl.BufferStorage && gl.FenceSync && gl.ClientWaitSync && gl.DeleteSync &&
+                                (gl_version_at_least(4, 4) || glfwExtensionSupported("GL_ARB_buffer_storage")) &&
+                                (gl_version_at_least(3, 2) || glfwExtensionSupported("GL_ARB_sync"));
+    if (preferred == UploadPath::PersistentPbo && has_persistent) {
+        return UploadPath::PersistentPbo;
+    }
+    return UploadPath::Pbo;
+}
+
+bool TextureUploader::create_buffers() {
+    if (path == UploadPath::PersistentPbo) {
+        // 一个缓冲区分成 kBuffers 段，整个生命周期只映射一次
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        gl.GenBuffers(1, pbo);
+        gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[0]);
+        gl.BufferStorage(GL_PIXEL_UNPACK_BUFFER, frame_bytes * kBuffers, nullptr, flags);
+        persistent = static_cast<uint8_t*>(gl.MapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, frame_bytes * kBuffers, flags));
+        gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return persistent != nullptr;
+    }
+    gl.GenBuffers(kBuffers, pbo);
+    for (int i = 0; i < kBuffers; ++i) {
+        gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[i]);
+        gl.BufferData(GL_PIXEL_UNPACK_BUFFER, frame_bytes, nullptr, GL_STREAM_DRAW);
+    }
+    gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return glGetError() == GL_NO_ERROR;
+}
+
+void TextureUploader::destroy_buffers() {
+    for (int i = 0; i < kBuffers; ++i) {
+        if (fences[i] != nullptr) {
+            gl.DeleteSync(fences[i]);
+            fences[i] = nullptr;
+        }
+    }
+    if (persistent != nullptr) {
+        gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[0]);
+        gl.UnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        persistent = nullptr;
+    }
+    if (pbo[0] != 0) {
+        gl.DeleteBuffers(kBuffers, pbo);  // 名字为 0 的项会被忽略
+        for (int i = 0; i < kBuffers; ++i) {
+            pbo[i] = 0;
+        }
+    }
+    next = 0;
+}
+
+bool TextureUploader::create(int width, int height, UploadPath preferred) {
+    destroy();
+    if (width <= 0 || height <= 0) {
+        std::cerr << "无效的纹理尺寸: " << width << "x" << height << std::endl;
+        return false;
+    }
+    this->width = width;
+    this->height = height;
+    frame_bytes = static_cast<size_t>(width) * height * 4;
+    preferred_path = preferred;
+
+    glGenTextures(1, &texture);
+    std::cout << "Texture ID: " << texture << std::endl;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // 4 字节像素：行天然 4 字节对齐，GL_BGRA 与大多数 GPU 的内部排列一致，驱动不需要逐像素重排
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+
+    path = choose_path(preferred);
+    if (path != UploadPath::Direct && !create_buffers()) {
+        std::cerr << "无法创建像素缓冲对象，改为直接上传" << std::endl;
+        destroy_buffers();
+        path = UploadPath::Direct;
+    }
+    std::cout << "纹理上传方式: " << upload_path_name(path) << std::endl;
+
+    GLenum err = glGetError();
+    if (err != GL_NO_ERROR) {
+        std::cerr << "OpenGL 错误: " << err << std::endl;
+    }
+    return texture != 0;
+}
+
+void TextureUploader::destroy() {
+    destroy_buffers();
+    if (texture != 0) {
+        glDeleteTextures(1, &texture);
+        texture = 0;
+    }
+    width = 0;
+    height = 0;
+    frame_bytes = 0;
+    uploaded_generation = 0;
+}
+
+bool TextureUploader::wait_segment(int index) {
+    if (fences[index] == nullptr) {
+        return true;
+    }
+    GLenum result = gl.ClientWaitSync(fences[index], 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+        // 三段都还在 GPU 手里：说明渲染比采集慢，只能等
+        ++upload_stats.fence_stalls;
+        result = gl.ClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);  // 100ms
+    }
+    if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+        return false;  // fence 保留，下次再等
+    }
+    gl.DeleteSync(fences[index]);
+    fences[index] = nullptr;
+    return true;
+}
+
+void TextureUploader::write_bgra(const cv::Mat& frame, uint8_t* dst) {
+    // 目标是写合并的驱动内存：只顺序写一遍，不读回
+    cv::Mat staging(frame.rows, frame.cols, CV_8UC4, dst);
+    if (frame.channels() == 4) {
+        frame.copyTo(staging);
+    } else {
+        cv::cvtColor(frame, staging, cv::COLOR_BGR2BGRA);
+    }
+}
+
+bool TextureUploader::upload(const cv::Mat& frame, uint64_t generation) {
+    if (generation != 0 && generation == uploaded_generation && texture != 0) {
+        ++upload_stats.skipped;  // UI 刷新比采集快：同一帧不重复上传
+        return true;
+    }
+    if (frame.empty()) {
+        std::cerr << "update_texture: frame is empty!" << std::endl;
+        return false;
+    }
+    if (frame.type() != CV_8UC3 && frame.type() != CV_8UC4) {
+        std::cerr << "update_texture: 不支持的帧类型 " << frame.type() << std::endl;
+        return false;
+    }
+    if (texture == 0 || frame.cols != width || frame.rows != height) {
+        if (!create(frame.cols, frame.rows, preferred_path)) {
+            return false;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    glBindTexture(GL_TEXTURE_2D, texture);
+    switch (path) {
+    case UploadPath::Direct:
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, frame.channels() == 4 ? GL_BGRA : GL_BGR,
+                        GL_UNSIGNED_BYTE, frame.data);
+        upload_stats.last_copy_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        break;
+    case UploadPath::Pbo: {
+        gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[next]);
+        // 先孤立旧存储：GPU 可能还在读这个缓冲区上一轮的内容，驱动另给一块，映射不用等
+        gl.BufferData(GL_PIXEL_UNPACK_BUFFER, frame_bytes, nullptr, GL_STREAM_DRAW);
+        void* dst = gl.MapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, frame_bytes,
+                                      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (dst == nullptr) {
+            gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            std::cerr << "无法映射像素缓冲对象" << std::endl;
+            return false;
+        }
+        write_bgra(frame, static_cast<uint8_t*>(dst));
+        gl.UnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        upload_stats.last_copy_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        // 源地址是缓冲区内的偏移：命令立即返回，拷贝由 GPU 完成
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+        gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        break;
+    }
+    case UploadPath::PersistentPbo: {
+        if (!wait_segment(next)) {
+            std::cerr << "等待纹理上传分段超时，跳过本帧" << std::endl;
+            return false;
+        }
+        const size_t offset = next * frame_bytes;
+        write_bgra(frame, persistent + offset);
+        upload_stats.last_copy_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[0]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE,
+                        reinterpret_cast<const void*>(offset));
+        gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        // GPU 读完这一段后 fence 才会触发，轮回到这一段时据此判断能否覆盖
+        fences[next] = gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        break;
+    }
+    }
+    next = (next + 1) % kBuffers;
+    uploaded_generation = generation;
+    ++upload_stats.uploads;
+
+    GLenum err = glGetError();
+    if (err != GL_NO_ERROR) {
+        std::cerr << "OpenGL 错误: " << err << std::endl;
+    }
+    return true;
+}
@@ -0,0 +1,247 @@
+#include "video_sink.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+extern char** environ;
+
+namespace {
+
+// cv::VideoWriter：只接受 BGR
+class OpenCvSink : public VideoSink {
+    cv::VideoWriter writer;
+public:
+    bool open(const std::string& path, int codec, double fps, const cv::Size& size) {
+        return writer.open(path, codec, fps, size);
+    }
+    bool write(const cv::Mat& frame) override {
+        writer.write(frame);
+        return true;
+    }
+    bool release() override {
+        writer.release();
+        return true;
+    }
+};
+
+// ffmpeg 子进程：标准输入是原始 NV12 帧流
+class FfmpegNv12Sink : public VideoSink {
+    pid_t pid = -1;
+    int pipe_fd = -1;
+    cv::Size size;
+    cv::Mat converted;  // BGR 帧转换后的 NV12，逐帧复用
+    bool failed = false;
+
+    bool write_all(const uint8_t* data, size_t length);
+public:
+    ~FfmpegNv12Sink() override { release(); }
+    bool open(const std::string& path, int codec, double fps, const cv::Size& size);
+    bool write(const cv::Mat& frame) override;
+    bool release() override;
+};
+
+// fourcc 对应的 ffmpeg 编码器，不认识的返回空，由 ffmpeg 按扩展名选
+const char* encoder_for(int codec) {
+    struct Entry {
+        int fourcc;
+        const char* encoder;
+    };
+    static const Entry entries[] = {
+        {cv::VideoWriter::fourcc('a', 'v', 'c', '1'), "libx264"},
+        {cv::VideoWriter::fourcc('H', '2', '6', '4'), "libx264"},
+        {cv::VideoWriter::fourcc('h', '2', '6', '4'), "libx264"},
+        {cv::VideoWriter::fourcc('X', '2', '6', '4'), "libx264"},
+        {cv::VideoWriter::fourcc('m', 'p', '4', 'v'), "mpeg4"},
+        {cv::VideoWriter::fourcc('M', 'P', '4', 'V'), "mpeg4"},
+        {cv::VideoWriter::fourcc('X', 'V', 'I', 'D'), "mpeg4"},
+        {cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), "mjpeg"},
+    };
+    for (const Entry& entry : entries) {
+        if (entry.fourcc == codec) {
+            return entry.encoder;
+        }
+    }
+    return nullptr;
+}
+
+bool FfmpegNv12Sink::open(const std::string& path, int codec, double fps, const cv::Size& size) {
+    this->size = size;
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        return false;
+    }
+    char dimensions[32];
+    char rate[32];
+    std::snprintf(dimensions, sizeof(dimensions), "%dx%d", size.width, size.height);
+    std::snprintf(rate, sizeof(rate), "%.3f", fps);
+    std::vector<const char*> argv = {"ffmpeg", "-loglevel", "error", "-y",
+                                     "-f", "rawvideo", "-pix_fmt", "nv12", "-s", dimensions, "-r", rate, "-i", "-"};
+    if (const char* encoder = encoder_for(codec)) {
+        argv.push_back("-c:v");
+        argv.push_back(encoder);
+    }
+    argv.push_back(path.c_str());
+    argv.push_back(nullptr);
+
+    // 读端接到子进程的标准输入（dup2 出来的描述符不带 O_CLOEXEC），其余描述符 exec 时关闭
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+    const bool spawned = posix_spawnp(&pid, "ffmpeg", &actions, nullptr, const_cast<char* const*>(argv.data()), environ) == 0;
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[0]);
+    if (!spawned) {
+        pid = -1;
+        close(fds[1]);
+        return false;
+    }
+    pipe_fd = fds[1];
+    return true;
+}
+
+bool FfmpegNv12Sink::write_all(const uint8_t* data, size_t length) {
+    // ffmpeg 提前退出时写管道会收到 SIGPIPE，默认处理会结束整个进程：
+    // 写的时候在本线程屏蔽它，出错时把挂起的信号取走
+    sigset_t pipe_set;
+    sigset_t old_set;
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+    bool ok = true;
+    while (length > 0) {
+        const ssize_t n = ::write(pipe_fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EPIPE) {
+                const struct timespec zero = {0, 0};
+                sigtimedwait(&pipe_set, nullptr, &zero);
+            }
+            ok = false;
+            break;
+        }
+        data += n;
+        length -= static_cast<size_t>(n);
+    }
+    pthread_sigmask(SIG_SETMASK, &old_set, nullptr);
+    return ok;
+}
+
+bool FfmpegNv12Sink::write(const cv::Mat& frame) {
+    if (pipe_fd < 0 || failed) {
+        return false;
+    }
+    const cv::Mat* nv12 = &frame;
+    if (frame.type() == CV_8UC3 && frame.size() == size) {
+        bgr_to_nv12(frame, converted);
+        nv12 = &converted;
+    } else if (frame.type() != CV_8UC1 || frame.cols != size.width || frame.rows != size.height * 3 / 2) {
+        return false;  // 尺寸不符的帧不写，与 cv::VideoWriter 一致
+    }
+    const size_t row_bytes = static_cast<size_t>(size.width);
+    if (nv12->isContinuous()) {
+        failed = !write_all(nv12->data, row_bytes * nv12->rows);
+    } else {
+        for (int y = 0; y < nv12->rows && !failed; ++y) {
+            failed = !write_all(nv12->ptr(y), row_bytes);
+        }
+    }
+    if (failed) {
+        std::cerr << "ffmpeg 编码进程已退出，后续帧不再写入" << std::endl;
+    }
+    return !failed;
+}
+
+bool FfmpegNv12Sink::release() {
+    if (pid < 0) {
+        return false;
+    }
+    close(pipe_fd);  // ffmpeg 读到文件结束，写完文件尾后退出
+    pipe_fd = -1;
+    int status = 0;
+    pid_t waited;
+    do {
+        waited = waitpid(pid, &status, 0);
+    } while (waited < 0 && errno == EINTR);
+    pid = -1;
+    if (waited < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cerr << "ffmpeg 编码失败" << std::endl;
+        return false;
+    }
+    return !failed;
+}
+
+}  // namespace
+
+std::unique_ptr<VideoSink> open_video_sink(const std::string& path, int codec, double fps,
+                                           const cv::Size& size, bool nv12) {
+    if (nv12) {
+        std::unique_ptr<FfmpegNv12Sink> sink(new FfmpegNv12Sink());
+        if (size.width % 2 != 0 || size.height % 2 != 0 || !sink->open(path, codec, fps, size)) {
+            return nullptr;
+        }
+        return sink;
+    }
+    std::unique_ptr<OpenCvSink> sink(new OpenCvSink());
+    if (!sink->open(path, codec, fps, size)) {
+        return nullptr;
+    }
+    return sink;
+}
+
+bool ffmpeg_available() {
+    static const bool available = []() {
+        const char* path = std::getenv("PATH");
+        const std::string dirs = path != nullptr ? path : "/usr/local/bin:/usr/bin:/bin";
+        size_t start = 0;
+        while (start <= dirs.size()) {
+            size_t end = dirs.find(':', start);
+            if (end == std::string::npos) {
+                end = dirs.size();
+            }
+            const std::string dir = end > start ? dirs.substr(start, end - start) : ".";
+            if (access((dir + "/ffmpeg").c_str(), X_OK) == 0) {
+                return true;
+            }
+            start = end + 1;
+        }
+        return false;
+    }();
+    return available;
+}
+
+cv::Size video_frame_size(const cv::Mat& frame, bool nv12) {
+    if (nv12 && frame.type() == CV_8UC1) {
+        return cv::Size(frame.cols, frame.rows * 2 / 3);
+    }
+    return frame.size();
+}
+
+void bgr_to_nv12(const cv::Mat& bgr, cv::Mat& nv12) {
+    // OpenCV 只能转成三平面的 I420，再把 U、V 平面交错成 NV12 的 UV 平面
+    cv::Mat i420;
+    cv::cvtColor(bgr, i420, cv::COLOR_BGR2YUV_I420);
+    const int width = bgr.cols;
+    const int height = bgr.rows;
+    nv12.create(height * 3 / 2, width, CV_8UC1);
+    cv::Mat y_plane = nv12.rowRange(0, height);
+    i420.rowRange(0, height).copyTo(y_plane);
+    const uint8_t* u = i420.ptr(height);
+    const uint8_t* v = u + (width / 2) * (height / 2);
+    for (int y = 0; y < height / 2; ++y) {
+        uint8_t* uv = nv12.ptr(height + y);
+        for (int x = 0; x < width / 2; ++x) {
+            uv[x * 2] = u[y * (width / 2) + x];
+            uv[x * 2 + 1] = v[y * (width / 2) + x];
+        }
+    }
+}
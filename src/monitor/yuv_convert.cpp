@@ -0,0 +1,473 @@
+#include "yuv_convert.h"
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define YUV_CONVERT_X86 1
+#endif
+
+// BT.601 limited range:
+//   R = 1.164(Y-16) + 1.596(V-128)
+//   G = 1.164(Y-16) - 0.391(U-128) - 0.813(V-128)
+//   B = 1.164(Y-16) + 2.018(U-128)
+// 每一项都按 SIMD 的 mulhi_epi16((x << 7), c) 计算：c 为 Q11 系数，结果保留 2 位小数，
+// 最后 (sum + 2) >> 2 并饱和到 0..255。标量实现逐位复现这一过程，保证各内核结果一致
+namespace {
+
+const int kCoefY = 2384;   // 1.164 * 2048
+const int kCoefRV = 3269;  // 1.596 * 2048
+const int kCoefGU = 801;   // 0.391 * 2048
+const int kCoefGV = 1665;  // 0.813 * 2048
+const int kCoefBU = 4133;  // 2.018 * 2048
+
+inline int mulhi(int x, int c) {
+    return (x * 128 * c) >> 16;
+}
+
+inline uint8_t clamp_q2(int v) {
+    v = (v + 2) >> 2;
+    return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+inline int bytes_per_pixel(PixelLayout layout) {
+    return layout == PixelLayout::BGR ? 3 : 4;
+}
+
+void row_scalar(const uint8_t* s, uint8_t* d, int width, PixelLayout layout) {
+    const int bpp = bytes_per_pixel(layout);
+    for (int x = 0; x + 1 < width; x += 2, s += 4) {
+        const int u = s[1] - 128;
+        const int v = s[3] - 128;
+        const int cr = mulhi(v, kCoefRV);
+        const int cg = mulhi(u, kCoefGU) + mulhi(v, kCoefGV);
+        const int cb = mulhi(u, kCoefBU);
+        for (int k = 0; k < 2; ++k, d += bpp) {
+            const int y = mulhi(s[k * 2] - 16, kCoefY);
+            const uint8_t r = clamp_q2(y + cr);
+            const uint8_t g = clamp_q2(y - cg);
+            const uint8_t b = clamp_q2(y + cb);
+            switch (layout) {
+            case PixelLayout::BGR:
+                d[0] = b; d[1] = g; d[2] = r;
+                break;
+            case PixelLayout::BGRA:
+                d[0] = b; d[1] = g; d[2] = r; d[3] = 255;
+                break;
+            case PixelLayout::RGBA:
+                d[0] = r; d[1] = g; d[2] = b; d[3] = 255;
+                break;
+            case PixelLayout::NV12:
+                break;  // 不是打包排列，调用方不会传入
+            }
+        }
+    }
+}
+
+#ifdef YUV_CONVERT_X86
+
+// 16 个像素的 B/G/R 平面交织为 48 字节 BGR 所需的 pshufb 掩码：[输出块][通道][字节]
+struct BgrShuffle {
+    uint8_t mask[3][3][16];
+};
+
+constexpr BgrShuffle make_bgr_shuffle() {
+    BgrShuffle t{};
+    for (int chunk = 0; chunk < 3; ++chunk) {
+        for (int ch = 0; ch < 3; ++ch) {
+            for (int k = 0; k < 16; ++k) {
+                const int p = chunk * 16 + k;
+                t.mask[chunk][ch][k] = (p % 3 == ch) ? static_cast<uint8_t>(p / 3) : 0x80;
+            }
+        }
+    }
+    return t;
+}
+
+constexpr BgrShuffle kBgrShuffle = make_bgr_shuffle();
+
+// 把 16 个像素的 8 位 B/G/R 写成目标排列（所有 x86 内核共用）
+__attribute__((target("sse4.1"), always_inline))
+inline void store16(__m128i b, __m128i g, __m128i r, uint8_t* d, PixelLayout layout) {
+    if (layout == PixelLayout::BGR) {
+        for (int chunk = 0; chunk < 3; ++chunk) {
+            const __m128i mb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(kBgrShuffle.mask[chunk][0]));
+            const __m128i mg = _mm_loadu_si128(reinterpret_cast<const __m128i*>(kBgrShuffle.mask[chunk][1]));
+            const __m128i mr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(kBgrShuffle.mask[chunk][2]));
+            const __m128i out = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(b, mb), _mm_shuffle_epi8(g, mg)),
+                                             _mm_shuffle_epi8(r, mr));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d + chunk * 16), out);
+        }
+        return;
+    }
+    if (layout == PixelLayout::RGBA) {
+        const __m128i t = b;
+        b = r;
+        r = t;
+    }
+    const __m128i alpha = _mm_set1_epi8(static_cast<char>(0xFF));
+    const __m128i bg_lo = _mm_unpacklo_epi8(b, g);
+    const __m128i bg_hi = _mm_unpackhi_epi8(b, g);
+    const __m128i ra_lo = _mm_unpacklo_epi8(r, alpha);
+    const __m128i ra_hi = _mm_unpackhi_epi8(r, alpha);
+    __m128i* out = reinterpret_cast<__m128i*>(d);
+    _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(bg_lo, ra_lo));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(bg_lo, ra_lo));
+    _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(bg_hi, ra_hi));
+    _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(bg_hi, ra_hi));
+}
+
+// 每次处理 16 个像素（32 字节 YUYV）
+__attribute__((target("sse4.1")))
+void row_sse41(const uint8_t* s, uint8_t* d, int width, PixelLayout layout) {
+    const int bpp = bytes_per_pixel(layout);
+    const __m128i mask_y = _mm_set1_epi16(0x00FF);
+    const __m128i mask_u = _mm_set1_epi32(0x0000FFFF);
+    const __m128i c16 = _mm_set1_epi16(16);
+    const __m128i c128 = _mm_set1_epi16(128);
+    const __m128i round = _mm_set1_epi16(2);
+    const __m128i cy = _mm_set1_epi16(kCoefY);
+    const __m128i crv = _mm_set1_epi16(kCoefRV);
+    const __m128i cgu = _mm_set1_epi16(kCoefGU);
+    const __m128i cgv = _mm_set1_epi16(kCoefGV);
+    const __m128i cbu = _mm_set1_epi16(kCoefBU);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x * 2));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x * 2 + 16));
+
+        // Y：每个 16 位通道的低字节
+        __m128i y0 = _mm_and_si128(a, mask_y);
+        __m128i y1 = _mm_and_si128(b, mask_y);
+        y0 = _mm_mulhi_epi16(_mm_slli_epi16(_mm_sub_epi16(y0, c16), 7), cy);
+        y1 = _mm_mulhi_epi16(_mm_slli_epi16(_mm_sub_epi16(y1, c16), 7), cy);
+
+        // U/V：高字节依次为 U0 V0 U1 V1 ...，拆开后每个像素对一组
+        const __m128i uv0 = _mm_srli_epi16(a, 8);
+        const __m128i uv1 = _mm_srli_epi16(b, 8);
+        __m128i u = _mm_packus_epi32(_mm_and_si128(uv0, mask_u), _mm_and_si128(uv1, mask_u));
+        __m128i v = _mm_packus_epi32(_mm_srli_epi32(uv0, 16), _mm_srli_epi32(uv1, 16));
+        u = _mm_slli_epi16(_mm_sub_epi16(u, c128), 7);
+        v = _mm_slli_epi16(_mm_sub_epi16(v, c128), 7);
+
+        const __m128i cr = _mm_mulhi_epi16(v, crv);
+        const __m128i cg = _mm_add_epi16(_mm_mulhi_epi16(u, cgu), _mm_mulhi_epi16(v, cgv));
+        const __m128i cb = _mm_mulhi_epi16(u, cbu);
+
+        // 色度项复制给像素对中的两个像素
+        const __m128i r0 = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(y0, _mm_unpacklo_epi16(cr, cr)), round), 2);
+        const __m128i r1 = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(y1, _mm_unpackhi_epi16(cr, cr)), round), 2);
+        const __m128i g0 = _mm_srai_epi16(_mm_add_epi16(_mm_sub_epi16(y0, _mm_unpacklo_epi16(cg, cg)), round), 2);
+        const __m128i g1 = _mm_srai_epi16(_mm_add_epi16(_mm_sub_epi16(y1, _mm_unpackhi_epi16(cg, cg)), round), 2);
+        const __m128i b0 = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(y0, _mm_unpacklo_epi16(cb, cb)), round), 2);
+        const __m128i b1 = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(y1, _mm_unpackhi_epi16(cb, cb)), round), 2);
+
+        store16(_mm_packus_epi16(b0, b1), _mm_packus_epi16(g0, g1), _mm_packus_epi16(r0, r1),
+                d + x * bpp, layout);
+    }
+    if (x < width) {
+        row_scalar(s + x * 2, d + x * bpp, width - x, layout);
+    }
+}
+
+// 每次处理 32 个像素；各 128 位通道独立计算，最后用 permute 恢复像素顺序
+__attribute__((target("avx2")))
+void row_avx2(const uint8_t* s, uint8_t* d, int width, PixelLayout layout) {
+    const int bpp = bytes_per_pixel(layout);
+    const __m256i mask_y = _mm256_set1_epi16(0x00FF);
+    const __m256i mask_u = _mm256_set1_epi32(0x0000FFFF);
+    const __m256i c16 = _mm256_set1_epi16(16);
+    const __m256i c128 = _mm256_set1_epi16(128);
+    const __m256i round = _mm256_set1_epi16(2);
+    const __m256i cy = _mm256_set1_epi16(kCoefY);
+    const __m256i crv = _mm256_set1_epi16(kCoefRV);
+    const __m256i cgu = _mm256_set1_epi16(kCoefGU);
+    const __m256i cgv = _mm256_set1_epi16(kCoefGV);
+    const __m256i cbu = _mm256_set1_epi16(kCoefBU);
+
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + x * 2));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + x * 2 + 32));
+
+        __m256i y0 = _mm256_and_si256(a, mask_y);
+        __m256i y1 = _mm256_and_si256(b, mask_y);
+        y0 = _mm256_mulhi_epi16(_mm256_slli_epi16(_mm256_sub_epi16(y0, c16), 7), cy);
+        y1 = _mm256_mulhi_epi16(_mm256_slli_epi16(_mm256_sub_epi16(y1, c16), 7), cy);
+
+        // 按通道打包后 unpacklo 对应 a 的像素、unpackhi 对应 b 的像素，与 y0/y1 的排列一致
+        const __m256i uv0 = _mm256_srli_epi16(a, 8);
+        const __m256i uv1 = _mm256_srli_epi16(b, 8);
+        __m256i u = _mm256_packus_epi32(_mm256_and_si256(uv0, mask_u), _mm256_and_si256(uv1, mask_u));
+        __m256i v = _mm256_packus_epi32(_mm256_srli_epi32(uv0, 16), _mm256_srli_epi32(uv1, 16));
+        u = _mm256_slli_epi16(_mm256_sub_epi16(u, c128), 7);
+        v = _mm256_slli_epi16(_mm256_sub_epi16(v, c128), 7);
+
+        const __m256i cr = _mm256_mulhi_epi16(v, crv);
+        const __m256i cg = _mm256_add_epi16(_mm256_mulhi_epi16(u, cgu), _mm256_mulhi_epi16(v, cgv));
+        const __m256i cb = _mm256_mulhi_epi16(u, cbu);
+
+        const __m256i r0 = _mm256_srai_epi16(_mm256_add_epi16(_mm256_add_epi16(y0, _mm256_unpacklo_epi16(cr, cr)), round), 2);
+        const __m256i r1 = _mm256_srai_epi16(_mm256_add_epi16(_mm256_add_epi16(y1, _mm256_unpackhi_epi16(cr, cr)), round), 2);
+        const __m256i g0 = _mm256_srai_epi16(_mm256_add_epi16(_mm256_sub_epi16(y0, _mm256_unpacklo_epi16(cg, cg)), round), 2);
+        const __m256i g1 = _mm256_srai_epi16(_mm256_add_epi16(_mm256_sub_epi16(y1, _mm256_unpackhi_epi16(cg, cg)), round), 2);
+        const __m256i b0 = _mm256_srai_epi16(_mm256_add_epi16(_mm256_add_epi16(y0, _mm256_unpacklo_epi16(cb, cb)), round), 2);
+        const __m256i b1 = _mm256_srai_epi16(_mm256_add_epi16(_mm256_add_epi16(y1, _mm256_unpackhi_epi16(cb, cb)), round), 2);
+
+        // packus 按通道交错，64 位块顺序为 0 2 1 3
+        const __m256i r8 = _mm256_permute4x64_epi64(_mm256_packus_epi16(r0, r1), 0xD8);
+        const __m256i g8 = _mm256_permute4x64_epi64(_mm256_packus_epi16(g0, g1), 0xD8);
+        const __m256i b8 = _mm256_permute4x64_epi64(_mm256_packus_epi16(b0, b1), 0xD8);
+
+        store16(_mm256_castsi256_si128(b8), _mm256_castsi256_si128(g8), _mm256_castsi256_si128(r8),
+                d + x * bpp, layout);
+        store16(_mm256_extracti128_si256(b8, 1), _mm256_extracti128_si256(g8, 1), _mm256_extracti128_si256(r8, 1),
+                d + (x + 16) * bpp, layout);
+    }
+    if (x < width) {
+        row_sse41(s + x * 2, d + x * bpp, width - x, layout);
+    }
+}
+
+// 每次处理 64 个像素，思路同 AVX2，四个 128 位通道
+__attribute__((target("avx512f,avx512bw")))
+void row_avx512(const uint8_t* s, uint8_t* d, int width, PixelLayout layout) {
+    const int bpp = bytes_per_pixel(layout);
+    const __m512i mask_y = _mm512_set1_epi16(0x00FF);
+    const __m512i mask_u = _mm512_set1_epi32(0x0000FFFF);
+    const __m512i c16 = _mm512_set1_epi16(16);
+    const __m512i c128 = _mm512_set1_epi16(128);
+    const __m512i round = _mm512_set1_epi16(2);
+    const __m512i cy = _mm512_set1_epi16(kCoefY);
+    const __m512i crv = _mm512_set1_epi16(kCoefRV);
+    const __m512i cgu = _mm512_set1_epi16(kCoefGU);
+    const __m512i cgv = _mm512_set1_epi16(kCoefGV);
+    const __m512i cbu = _mm512_set1_epi16(kCoefBU);
+    // packus 之后 64 位块为 a0 b0 a1 b1 a2 b2 a3 b3，重排为 a0..a3 b0..b3
+    const __m512i order = _mm512_set_epi64(7, 5, 3, 1, 6, 4, 2, 0);
+    // 移位、重排和取 128 位这三个内在函数的非掩码版本在 GCC 12 里以未定义值作合并源，
+    // 在 target 属性的函数里会报 -Wmaybe-uninitialized；改用全 1 掩码的清零版本，指令相同
+    const __mmask16 all16 = 0xFFFF;
+    const __mmask8 all8 = 0xFF;
+    const __mmask8 all4 = 0x0F;
+
+    int x = 0;
+    for (; x + 64 <= width; x += 64) {
+        const __m512i a = _mm512_loadu_si512(s + x * 2);
+        const __m512i b = _mm512_loadu_si512(s + x * 2 + 64);
+
+        __m512i y0 = _mm512_and_si512(a, mask_y);
+        __m512i y1 = _mm512_and_si512(b, mask_y);
+        y0 = _mm512_mulhi_epi16(_mm512_slli_epi16(_mm512_sub_epi16(y0, c16), 7), cy);
+        y1 = _mm512_mulhi_epi16(_mm512_slli_epi16(_mm512_sub_epi16(y1, c16), 7), cy);
+
+        const __m512i uv0 = _mm512_srli_epi16(a, 8);
+        const __m512i uv1 = _mm512_srli_epi16(b, 8);
+        __m512i u = _mm512_packus_epi32(_mm512_and_si512(uv0, mask_u), _mm512_and_si512(uv1, mask_u));
+        __m512i v = _mm512_packus_epi32(_mm512_maskz_srli_epi32(all16, uv0, 16), _mm512_maskz_srli_epi32(all16, uv1, 16));
+        u = _mm512_slli_epi16(_mm512_sub_epi16(u, c128), 7);
+        v = _mm512_slli_epi16(_mm512_sub_epi16(v, c128), 7);
+
+        const __m512i cr = _mm512_mulhi_epi16(v, crv);
+        const __m512i cg = _mm512_add_epi16(_mm512_mulhi_epi16(u, cgu), _mm512_mulhi_epi16(v, cgv));
+        const __m512i cb = _mm512_mulhi_epi16(u, cbu);
+
+        const __m512i r0 = _mm512_srai_epi16(_mm512_add_epi16(_mm512_add_epi16(y0, _mm512_unpacklo_epi16(cr, cr)), round), 2);
+        const __m512i r1 = _mm512_srai_epi16(_mm512_add_epi16(_mm512_add_epi16(y1, _mm512_unpackhi_epi16(cr, cr)), round), 2);
+        const __m512i g0 = _mm512_srai_epi16(_mm512_add_epi16(_mm512_sub_epi16(y0, _mm512_unpacklo_epi16(cg, cg)), round), 2);
+        const __m512i g1 = _mm512_srai_epi16(_mm512_add_epi16(_mm512_sub_epi16(y1, _mm512_unpackhi_epi16(cg, cg)), round), 2);
+        const __m512i b0 = _mm512_srai_epi16(_mm512_add_epi16(_mm512_add_epi16(y0, _mm512_unpacklo_epi16(cb, cb)), round), 2);
+        const __m512i b1 = _mm512_srai_epi16(_mm512_add_epi16(_mm512_add_epi16(y1, _mm512_unpackhi_epi16(cb, cb)), round), 2);
+
+        const __m512i r8 = _mm512_maskz_permutexvar_epi64(all8, order, _mm512_packus_epi16(r0, r1));
+        const __m512i g8 = _mm512_maskz_permutexvar_epi64(all8, order, _mm512_packus_epi16(g0, g1));
+        const __m512i b8 = _mm512_maskz_permutexvar_epi64(all8, order, _mm512_packus_epi16(b0, b1));
+
+        store16(_mm512_maskz_extracti32x4_epi32(all4, b8, 0), _mm512_maskz_extracti32x4_epi32(all4, g8, 0), _mm512_maskz_extracti32x4_epi32(all4, r8, 0),
+                d + x * bpp, layout);
+        store16(_mm512_maskz_extracti32x4_epi32(all4, b8, 1), _mm512_maskz_extracti32x4_epi32(all4, g8, 1), _mm512_maskz_extracti32x4_epi32(all4, r8, 1),
+                d + (x + 16) * bpp, layout);
+        store16(_mm512_maskz_extracti32x4_epi32(all4, b8, 2), _mm512_maskz_extracti32x4_epi32(all4, g8, 2), _mm512_maskz_extracti32x4_epi32(all4, r8, 2),
+                d + (x + 32) * bpp, layout);
+        store16(_mm512_maskz_extracti32x4_epi32(all4, b8, 3), _mm512_maskz_extracti32x4_epi32(all4, g8, 3), _mm512_maskz_extracti32x4_epi32(all4, r8, 3),
+                d + (x + 48) * bpp, layout);
+    }
+    if (x < width) {
+        row_avx2(s + x * 2, d + x * bpp, width - x, layout);
+    }
+}
+
+#endif // YUV_CONVERT_X86
+
+typedef void (*RowKernel)(const uint8_t*, uint8_t*, int, PixelLayout);
+
+RowKernel kernel_for(SimdLevel level) {
+    switch (level) {
+#ifdef YUV_CONVERT_X86
+    case SimdLevel::AVX512:
+        return row_avx512;
+    case SimdLevel::AVX2:
+        return row_avx2;
+    case SimdLevel::SSE41:
+        return row_sse41;
+#endif
+    default:
+        return row_scalar;
+    }
+}
+
+// 把一行 Y 和一行交错的 UV 拼成 YUYV（Y0 U Y1 V），再交给 YUYV 内核
+void interleave_row(const uint8_t* y, const uint8_t* uv, uint8_t* d, int width) {
+    int x = 0;
+#ifdef YUV_CONVERT_X86
+    for (; x + 16 <= width; x += 16) {
+        __m128i vy = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x));
+        __m128i vuv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(uv + x));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + x * 2), _mm_unpacklo_epi8(vy, vuv));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + x * 2 + 16), _mm_unpackhi_epi8(vy, vuv));
+    }
+#endif
+    for (; x < width; ++x) {
+        d[x * 2] = y[x];
+        d[x * 2 + 1] = uv[x];
+    }
+}
+
+// YUYV 一行拆成 Y 行和交错 UV 行（偶数字节和奇数字节），uv 为空时只取 Y
+void split_yuyv_row(const uint8_t* s, uint8_t* y, uint8_t* uv, int width) {
+    int x = 0;
+#ifdef YUV_CONVERT_X86
+    const __m128i low = _mm_set1_epi16(0x00FF);
+    for (; x + 16 <= width; x += 16) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x * 2));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x * 2 + 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(y + x),
+                         _mm_packus_epi16(_mm_and_si128(a, low), _mm_and_si128(b, low)));
+        if (uv != nullptr) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(uv + x),
+                             _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+        }
+    }
+#endif
+    for (; x < width; ++x) {
+        y[x] = s[x * 2];
+        if (uv != nullptr) {
+            uv[x] = s[x * 2 + 1];
+        }
+    }
+}
+
+SimdLevel detect_level() {
+    if (yuyv_simd_supported(SimdLevel::AVX512)) {
+        return SimdLevel::AVX512;
+    }
+    if (yuyv_simd_supported(SimdLevel::AVX2)) {
+        return SimdLevel::AVX2;
+    }
+    if (yuyv_simd_supported(SimdLevel::SSE41)) {
+        return SimdLevel::SSE41;
+    }
+    return SimdLevel::Scalar;
+}
+
+std::atomic<SimdLevel>& active_level() {
+    static std::atomic<SimdLevel> level(detect_level());
+    return level;
+}
+
+} // namespace
+
+bool yuyv_simd_supported(SimdLevel level) {
+#ifdef YUV_CONVERT_X86
+    __builtin_cpu_init();
+    switch (level) {
+    case SimdLevel::AVX512:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    case SimdLevel::AVX2:
+        return __builtin_cpu_supports("avx2");
+    case SimdLevel::SSE41:
+        return __builtin_cpu_supports("sse4.1");
+    case SimdLevel::Scalar:
+        return true;
+    }
+    return false;
+#else
+    return level == SimdLevel::Scalar;
+#endif
+}
+
+SimdLevel yuyv_simd_level() {
+    return active_level().load(std::memory_order_relaxed);
+}
+
+const char* yuyv_simd_name(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::AVX512:
+        return "AVX-512";
+    case SimdLevel::AVX2:
+        return "AVX2";
+    case SimdLevel::SSE41:
+        return "SSE4.1";
+    case SimdLevel::Scalar:
+        return "scalar";
+    }
+    return "unknown";
+}
+
+bool yuyv_set_simd_level(SimdLevel level) {
+    if (!yuyv_simd_supported(level)) {
+        return false;
+    }
+    active_level().store(level, std::memory_order_relaxed);
+    return true;
+}
+
+void yuyv_convert(const uint8_t* src, size_t src_stride,
+                  uint8_t* dst, size_t dst_stride,
+                  int width, int height, PixelLayout layout) {
+    const RowKernel kernel = kernel_for(yuyv_simd_level());
+    width &= ~1;
+    for (int y = 0; y < height; ++y) {
+        kernel(src + y * src_stride, dst + y * dst_stride, width, layout);
+    }
+}
+
+void nv_convert(const uint8_t* y_plane, size_t y_stride,
+                const uint8_t* uv_plane, size_t uv_stride,
+                uint8_t* dst, size_t dst_stride,
+                int width, int height, int chroma_shift, PixelLayout layout) {
+    const RowKernel kernel = kernel_for(yuyv_simd_level());
+    width &= ~1;
+    thread_local std::vector<uint8_t> row;
+    row.resize(static_cast<size_t>(width) * 2);
+    for (int y = 0; y < height; ++y) {
+        interleave_row(y_plane + y * y_stride, uv_plane + (y >> chroma_shift) * uv_stride, row.data(), width);
+        kernel(row.data(), dst + y * dst_stride, width, layout);
+    }
+}
+
+void nv12_from_semi_planar(const uint8_t* y_plane, size_t y_stride,
+                           const uint8_t* uv_plane, size_t uv_stride,
+                           uint8_t* dst, size_t dst_stride,
+                           int width, int height, int chroma_shift) {
+    for (int y = 0; y < height; ++y) {
+        std::memcpy(dst + y * dst_stride, y_plane + y * y_stride, width);
+    }
+    uint8_t* uv_dst = dst + height * dst_stride;
+    const int uv_step = chroma_shift == 1 ? 1 : 2;  // 4:2:2 的 UV 每行都有，隔行取
+    for (int y = 0; y < height / 2; ++y) {
+        std::memcpy(uv_dst + y * dst_stride, uv_plane + y * uv_step * uv_stride, width);
+    }
+}
+
+void nv12_from_yuyv(const uint8_t* src, size_t src_stride,
+                    uint8_t* dst, size_t dst_stride,
+                    int width, int height) {
+    uint8_t* uv_dst = dst + height * dst_stride;
+    for (int y = 0; y < height; ++y) {
+        split_yuyv_row(src + y * src_stride, dst + y * dst_stride,
+                       y % 2 == 0 ? uv_dst + (y / 2) * dst_stride : nullptr, width);
+    }
+}
@@ -1,7 +1,8 @@
 #include "test_monitor.h"
-int main() {
+int main(int argc, char** argv) {
     // Run all tests
     MonitorTests::runAllTests();
+    MonitorTests::runAllBenchmarks();
     int frameCount = 100; // Number of frames to capture
     std::string frameCountStr = std::to_string(frameCount);
     std::cout << "Press Enter to start capturing " << frameCountStr << " frames..." << std::endl;
@@ -11,7 +12,8 @@ int main() {
         frameCount = std::atoi(tmp);
         std::cout << "Capturing " << frameCount << " frames..." << std::endl;
     }
-    Monitor monitor;
+    // Optional frame source, e.g. "synthetic:1280x720@30" on machines without a camera
+    Monitor monitor(argc > 1 ? argv[1] : "/dev/video0");
     monitor.capture();
     MonitorTests::convertMonitorFramesToVideo(monitor, frameCount, "test_video.mp4");
 